@@ -0,0 +1,122 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(_MSC_VER)
+#define BENCH_NOINLINE __declspec(noinline)
+#else
+#define BENCH_NOINLINE __attribute__((noinline))
+#endif
+
+// A minimal micro-benchmark harness, to avoid depending on a benchmark
+// library.
+namespace bench {
+
+// Makes the compiler assume value is used, such that computing it can't be
+// optimized away.
+template<typename T>
+inline void do_not_optimize(T const & value) {
+#if defined(__GNUC__) || defined(__clang__)
+	asm volatile("" : : "r,m"(value) : "memory");
+#else
+	static char const volatile * sink;
+	sink = reinterpret_cast<char const volatile *>(&value);
+#endif
+}
+
+// Returns x, without the compiler knowing its value. For scalars only.
+template<typename T>
+inline T opaque(T x) {
+#if defined(__GNUC__) || defined(__clang__)
+	asm volatile("" : "+r"(x));
+	return x;
+#else
+	T volatile v = x;
+	return v;
+#endif
+}
+
+// body(n, thread) is called on every thread at the same time, and should do
+// the measured operation n times.
+struct benchmark {
+	std::string name;
+	unsigned threads;
+	std::function<void(std::size_t n, unsigned thread)> body;
+};
+
+class registry {
+	std::vector<benchmark> benchmarks_;
+
+public:
+	template<typename F>
+	void add(std::string name, F body, unsigned threads = 1) {
+		benchmarks_.push_back({std::move(name), threads, std::function<void(std::size_t, unsigned)>(std::move(body))});
+	}
+
+	std::vector<benchmark> const & benchmarks() const { return benchmarks_; }
+};
+
+// 1, 2, 4, ... up to the number of hardware threads, and that number itself.
+inline std::vector<unsigned> thread_counts() {
+	unsigned max = std::thread::hardware_concurrency();
+	if (max == 0) max = 1;
+	std::vector<unsigned> counts;
+	for (unsigned n = 1; n < max; n *= 2) counts.push_back(n);
+	counts.push_back(max);
+	return counts;
+}
+
+// The wall time of running the benchmark with n iterations per thread,
+// in seconds.
+inline double time_once(benchmark const & b, std::size_t n) {
+	using clock = std::chrono::steady_clock;
+	if (b.threads <= 1) {
+		auto start = clock::now();
+		b.body(n, 0);
+		return std::chrono::duration<double>(clock::now() - start).count();
+	}
+	std::atomic<unsigned> ready{0};
+	std::atomic<bool> go{false};
+	std::vector<std::thread> threads;
+	for (unsigned t = 0; t < b.threads; ++t) {
+		threads.emplace_back([&, t] {
+			ready.fetch_add(1);
+			while (!go.load(std::memory_order_acquire)) {}
+			b.body(n, t);
+		});
+	}
+	while (ready.load() != b.threads) {}
+	auto start = clock::now();
+	go.store(true, std::memory_order_release);
+	for (auto & t : threads) t.join();
+	return std::chrono::duration<double>(clock::now() - start).count();
+}
+
+struct result {
+	double ns_per_op;
+	std::uint64_t iterations; // Per thread.
+};
+
+// Runs the benchmark with more and more iterations, until it takes at least
+// min_seconds.
+inline result run(benchmark const & b, double min_seconds) {
+	std::size_t n = 1;
+	while (true) {
+		double t = time_once(b, n);
+		if (t >= min_seconds || n >= (std::size_t(1) << 40)) return {t * 1e9 / double(n), n};
+		double grow = t > 0 ? min_seconds / t * 1.2 : 100;
+		if (grow > 100) grow = 100;
+		if (grow < 2) grow = 2;
+		n = std::size_t(double(n) * grow);
+	}
+}
+
+}
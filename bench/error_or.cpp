@@ -0,0 +1,86 @@
+#include <system_error>
+
+#if defined(__has_include)
+#if __has_include(<version>)
+#include <version>
+#endif
+#endif
+
+#if __cpp_lib_expected
+#include <expected>
+#endif
+
+#include <mstd/error_or.hpp>
+
+#include "bench.hpp"
+
+// The cost of returning a value or an error from a function that isn't
+// inlined, as error_or, as an exception, and as std::expected.
+
+namespace {
+
+BENCH_NOINLINE mstd::error_or<int> parse_error_or(int x) {
+	if (x < 0) return std::make_error_code(std::errc::invalid_argument);
+	return x;
+}
+
+// Trivially copyable, so returned in registers.
+BENCH_NOINLINE mstd::error_or<long, int> parse_error_or_int(int x) {
+	if (x < 0) return int(std::errc::invalid_argument);
+	return long(x);
+}
+
+#if __cpp_exceptions
+BENCH_NOINLINE int parse_throw(int x) {
+	if (x < 0) throw std::system_error(std::make_error_code(std::errc::invalid_argument));
+	return x;
+}
+#endif
+
+#if __cpp_lib_expected
+BENCH_NOINLINE std::expected<int, std::error_code> parse_expected(int x) {
+	if (x < 0) return std::unexpected(std::make_error_code(std::errc::invalid_argument));
+	return x;
+}
+#endif
+
+template<typename F>
+void add_pair(bench::registry & registry, char const * name, F f) {
+	registry.add(std::string(name) + "/success", [f] (std::size_t n, unsigned) {
+		for (std::size_t i = 0; i < n; ++i) bench::do_not_optimize(f(bench::opaque(1)));
+	});
+	registry.add(std::string(name) + "/failure", [f] (std::size_t n, unsigned) {
+		for (std::size_t i = 0; i < n; ++i) bench::do_not_optimize(f(bench::opaque(-1)));
+	});
+}
+
+}
+
+void register_error_or_benchmarks(bench::registry & registry) {
+	add_pair(registry, "error_or<int>", [] (int x) {
+		auto r = parse_error_or(x);
+		return r ? *r : r.error().value();
+	});
+
+	add_pair(registry, "error_or<long,int>", [] (int x) {
+		auto r = parse_error_or_int(x);
+		return r ? *r : long(r.error());
+	});
+
+#if __cpp_exceptions
+	add_pair(registry, "exception", [] (int x) {
+		try {
+			return parse_throw(x);
+		} catch (std::system_error const & e) {
+			return e.code().value();
+		}
+	});
+#endif
+
+#if __cpp_lib_expected
+	add_pair(registry, "std::expected", [] (int x) {
+		auto r = parse_expected(x);
+		return r ? *r : r.error().value();
+	});
+#endif
+}
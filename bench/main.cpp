@@ -0,0 +1,68 @@
+// Runs the mstd micro-benchmarks, printing one JSON object per line:
+//
+//   {"name": "refcount_ptr/copy_shared", "threads": 4, "iterations": 16777216, "ns_per_op": 21.3}
+//
+// ns_per_op is the wall time divided by the iterations per thread. So for
+// multiple threads, it's the time an operation takes while the other threads
+// do the same thing.
+//
+// Options:
+//   --filter=<text>   Only run benchmarks of which the name contains text.
+//   --min-time=<s>    Run every benchmark for at least s seconds (default 0.2).
+//   --list            Only print the names.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include "bench.hpp"
+
+void register_error_or_benchmarks(bench::registry &);
+void register_range_benchmarks(bench::registry &);
+void register_refcount_benchmarks(bench::registry &);
+
+int main(int argc, char * * argv) {
+	std::string filter;
+	double min_time = 0.2;
+	bool list = false;
+
+	for (int i = 1; i < argc; ++i) {
+		char const * arg = argv[i];
+		if (std::strncmp(arg, "--filter=", 9) == 0) {
+			filter = arg + 9;
+		} else if (std::strncmp(arg, "--min-time=", 11) == 0) {
+			min_time = std::atof(arg + 11);
+		} else if (std::strcmp(arg, "--list") == 0) {
+			list = true;
+		} else {
+			std::fprintf(stderr, "Usage: %s [--filter=<text>] [--min-time=<seconds>] [--list]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	// Some standard libraries skip atomic operations (e.g. in std::shared_ptr)
+	// until the program starts a thread. Start one, such that single-threaded
+	// benchmarks measure the same code as multi-threaded programs run.
+	std::thread([] {}).join();
+
+	bench::registry registry;
+	register_error_or_benchmarks(registry);
+	register_range_benchmarks(registry);
+	register_refcount_benchmarks(registry);
+
+	for (auto const & b : registry.benchmarks()) {
+		if (b.name.find(filter) == std::string::npos) continue;
+		if (list) {
+			std::printf("%s threads=%u\n", b.name.c_str(), b.threads);
+			continue;
+		}
+		bench::result r = bench::run(b, min_time);
+		std::printf(
+			"{\"name\": \"%s\", \"threads\": %u, \"iterations\": %llu, \"ns_per_op\": %.3f}\n",
+			b.name.c_str(), b.threads, static_cast<unsigned long long>(r.iterations), r.ns_per_op
+		);
+		std::fflush(stdout);
+	}
+}
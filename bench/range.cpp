@@ -0,0 +1,79 @@
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <mstd/range.hpp>
+
+#include "bench.hpp"
+
+// Throughput of comparing and searching ranges of bytes, and of ints for
+// element-wise search.
+
+namespace {
+
+char const needle[] = "aaab";
+
+// Mostly 'a', with the needle at the end.
+std::vector<char> substring_haystack(std::size_t size) {
+	std::vector<char> a(size, 'a');
+	for (std::size_t i = 0; i + 4 <= size; i += 64) a[i + 3] = 'c';
+	for (std::size_t i = 0; i < 4 && i < size; ++i) a[size - 4 + i] = needle[i];
+	return a;
+}
+
+BENCH_NOINLINE std::size_t find_substring_loop(char const * p, std::size_t size) {
+	for (std::size_t i = 0; i + 4 <= size; ++i) {
+		std::size_t j = 0;
+		while (j < 4 && p[i + j] == needle[j]) ++j;
+		if (j == 4) return i;
+	}
+	return std::size_t(-1);
+}
+
+}
+
+void register_range_benchmarks(bench::registry & registry) {
+	for (std::size_t size : {16, 256, 4096, 65536}) {
+		// Built by appending, since GCC 12 wrongly warns about prepending with C++20.
+		auto name = [size] (char const * base) { return std::string(base) + "/" + std::to_string(size); };
+
+		registry.add(name("range/equal"), [size] (std::size_t n, unsigned) {
+			std::vector<char> a(size, 'x'), b(size, 'x');
+			for (std::size_t i = 0; i < n; ++i) {
+				bench::do_not_optimize(mstd::range<char const>(bench::opaque(a.data()), size) == mstd::range<char const>(b));
+			}
+		});
+
+		registry.add(name("range/find_byte"), [size] (std::size_t n, unsigned) {
+			std::vector<char> a(size, 'x');
+			a.back() = 'y';
+			for (std::size_t i = 0; i < n; ++i) {
+				bench::do_not_optimize(mstd::range<char const>(bench::opaque(a.data()), size).find('y'));
+			}
+		});
+
+		registry.add(name("range/find_int"), [size] (std::size_t n, unsigned) {
+			std::vector<int> a(size, 1);
+			a.back() = 2;
+			for (std::size_t i = 0; i < n; ++i) {
+				bench::do_not_optimize(mstd::range<int const>(bench::opaque(a.data()), size).find(2));
+			}
+		});
+
+		// A needle of which the first bytes occur often.
+		registry.add(name("range/find_substring"), [size] (std::size_t n, unsigned) {
+			std::vector<char> a = substring_haystack(size);
+			for (std::size_t i = 0; i < n; ++i) {
+				bench::do_not_optimize(mstd::range<char const>(bench::opaque(a.data()), size).find(mstd::range<char const>(needle, 4)));
+			}
+		});
+
+		// The same with a plain loop, for comparison.
+		registry.add(name("loop/find_substring"), [size] (std::size_t n, unsigned) {
+			std::vector<char> a = substring_haystack(size);
+			for (std::size_t i = 0; i < n; ++i) {
+				bench::do_not_optimize(find_substring_loop(bench::opaque(a.data()), size));
+			}
+		});
+	}
+}
@@ -0,0 +1,167 @@
+#include <atomic>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__has_include)
+#if __has_include(<version>)
+#include <version>
+#endif
+#endif
+
+#include <mstd/atomic_refcount_ptr.hpp>
+#include <mstd/refcount.hpp>
+
+#include "bench.hpp"
+
+namespace {
+
+struct object : mstd::refcounted {
+	int value = 0;
+};
+
+struct local_object : mstd::refcounted_local {
+	int value = 0;
+};
+
+}
+
+void register_refcount_benchmarks(bench::registry & registry) {
+	// A copy and destruction of a refcount_ptr to an object that all threads
+	// share, i.e. with contention on the reference count.
+	for (unsigned threads : bench::thread_counts()) {
+		registry.add("refcount_ptr/copy_shared", [] (std::size_t n, unsigned) {
+			static mstd::refcount_ptr<object> const shared = mstd::make_refcount<object>();
+			for (std::size_t i = 0; i < n; ++i) {
+				mstd::refcount_ptr<object> copy = shared;
+				bench::do_not_optimize(copy);
+			}
+		}, threads);
+	}
+
+	// The same, with an object per thread, i.e. without contention.
+	for (unsigned threads : bench::thread_counts()) {
+		registry.add("refcount_ptr/copy_private", [] (std::size_t n, unsigned) {
+			mstd::refcount_ptr<object> const mine = mstd::make_refcount<object>();
+			for (std::size_t i = 0; i < n; ++i) {
+				mstd::refcount_ptr<object> copy = mine;
+				bench::do_not_optimize(copy);
+			}
+		}, threads);
+	}
+
+	// std::shared_ptr, for comparison.
+	for (unsigned threads : bench::thread_counts()) {
+		registry.add("shared_ptr/copy_shared", [] (std::size_t n, unsigned) {
+			static std::shared_ptr<int> const shared = std::make_shared<int>();
+			for (std::size_t i = 0; i < n; ++i) {
+				std::shared_ptr<int> copy = shared;
+				bench::do_not_optimize(copy);
+			}
+		}, threads);
+	}
+
+	// Loads of a pointer that all threads share, like readers of a published
+	// snapshot.
+	for (unsigned threads : bench::thread_counts()) {
+		registry.add("atomic_refcount_ptr/load", [] (std::size_t n, unsigned) {
+			static mstd::atomic_refcount_ptr<object const> const shared(mstd::make_refcount<object const>());
+			for (std::size_t i = 0; i < n; ++i) {
+				mstd::refcount_ptr<object const> p = shared.load();
+				bench::do_not_optimize(p);
+			}
+		}, threads);
+	}
+
+	// The same, while thread 0 keeps replacing the pointer.
+	for (unsigned threads : bench::thread_counts()) {
+		if (threads < 2) continue;
+		registry.add("atomic_refcount_ptr/load_with_store", [] (std::size_t n, unsigned thread) {
+			static mstd::atomic_refcount_ptr<object const> shared(mstd::make_refcount<object const>());
+			for (std::size_t i = 0; i < n; ++i) {
+				if (thread == 0) {
+					shared.store(mstd::make_refcount<object const>());
+				} else {
+					mstd::refcount_ptr<object const> p = shared.load();
+					bench::do_not_optimize(p);
+				}
+			}
+		}, threads);
+	}
+
+#if __cpp_lib_atomic_shared_ptr
+	// std::atomic<std::shared_ptr>, for comparison. (Not lock-free in
+	// libstdc++.)
+	for (unsigned threads : bench::thread_counts()) {
+		registry.add("shared_ptr/atomic_load", [] (std::size_t n, unsigned) {
+			static std::atomic<std::shared_ptr<int const>> const shared(std::make_shared<int const>());
+			for (std::size_t i = 0; i < n; ++i) {
+				std::shared_ptr<int const> p = shared.load();
+				bench::do_not_optimize(p);
+			}
+		}, threads);
+	}
+
+	for (unsigned threads : bench::thread_counts()) {
+		if (threads < 2) continue;
+		registry.add("shared_ptr/atomic_load_with_store", [] (std::size_t n, unsigned thread) {
+			static std::atomic<std::shared_ptr<int const>> shared(std::make_shared<int const>());
+			for (std::size_t i = 0; i < n; ++i) {
+				if (thread == 0) {
+					shared.store(std::make_shared<int const>());
+				} else {
+					std::shared_ptr<int const> p = shared.load();
+					bench::do_not_optimize(p);
+				}
+			}
+		}, threads);
+	}
+#endif
+
+	registry.add("refcount_ptr/copy_local", [] (std::size_t n, unsigned) {
+		mstd::refcount_ptr<local_object> const p = mstd::make_refcount<local_object>();
+		for (std::size_t i = 0; i < n; ++i) {
+			mstd::refcount_ptr<local_object> copy = p;
+			bench::do_not_optimize(copy);
+		}
+	});
+
+	registry.add("refcount_ptr/copy_wrapped", [] (std::size_t n, unsigned) {
+		mstd::refcount_ptr<std::string> const p = mstd::make_refcount<std::string>("wrapped");
+		for (std::size_t i = 0; i < n; ++i) {
+			mstd::refcount_ptr<std::string> copy = p;
+			bench::do_not_optimize(copy);
+		}
+	});
+
+	registry.add("refcount_ptr/move", [] (std::size_t n, unsigned) {
+		mstd::refcount_ptr<object> a = mstd::make_refcount<object>();
+		mstd::refcount_ptr<object> b;
+		for (std::size_t i = 0; i < n; ++i) {
+			b = std::move(a);
+			bench::do_not_optimize(b);
+			a = std::move(b);
+			bench::do_not_optimize(a);
+		}
+	});
+
+	registry.add("refcount_ptr/make", [] (std::size_t n, unsigned) {
+		for (std::size_t i = 0; i < n; ++i) {
+			mstd::refcount_ptr<object> p = mstd::make_refcount<object>();
+			bench::do_not_optimize(p);
+		}
+	});
+
+	// 64 copies with a single increment, and dropping them with a single
+	// decrement.
+	registry.add("refcount_ptr/share_64", [] (std::size_t n, unsigned) {
+		mstd::refcount_ptr<object> const p = mstd::make_refcount<object>();
+		std::vector<mstd::refcount_ptr<object>> copies(64);
+		for (std::size_t i = 0; i < n; ++i) {
+			p.share(64, copies.begin());
+			bench::do_not_optimize(copies.data());
+			mstd::refcount_ptr<object>::reset_all(copies);
+		}
+	});
+}
@@ -0,0 +1,244 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#if defined(__has_include)
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#endif
+#endif
+
+#include "range.hpp"
+
+namespace mstd {
+
+namespace arena_detail {
+
+struct chunk {
+	chunk * next;
+	std::size_t size; // Not including the header.
+};
+
+// The constants of arena, in a template such that they can be defined in
+// this header before C++17.
+template<typename = void>
+struct constants {
+	static constexpr std::size_t header_size =
+		(sizeof(chunk) + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+
+	static constexpr std::size_t max_chunk_size = std::size_t(1) << 20;
+};
+
+#if __cplusplus < 201703L
+template<typename T>
+constexpr std::size_t constants<T>::header_size;
+
+template<typename T>
+constexpr std::size_t constants<T>::max_chunk_size;
+#endif
+
+// Kept out of line, to keep the exception out of the allocation paths.
+#if defined(__GNUC__) || defined(__clang__)
+__attribute__((noinline, cold))
+#endif
+[[noreturn]] inline void bad_alloc() {
+#if defined(__cpp_exceptions) || defined(__EXCEPTIONS) || defined(_CPPUNWIND)
+	throw std::bad_alloc();
+#else
+	std::abort();
+#endif
+}
+
+}
+
+// Memory that is allocated by bumping a pointer, and freed all at once.
+//
+// Memory is taken from chunks, which double in size up to 1 MiB. Requests that
+// don't fit in the next chunk get a chunk of their own, after which the
+// current chunk continues to be used. Deallocating is not possible, except for everything at once with reset(), which keeps
+// the largest chunk for reuse. Destructors are never run, so only trivially
+// destructible objects can be created with allocate<T>() and create<T>().
+//
+// An arena is not thread safe. Use one per thread, or per request.
+//
+// Example:
+//   thread_local mstd::arena request_arena;
+//
+//   void handle(Request const & request) {
+//     mstd::range<Token> tokens = request_arena.allocate<Token>(request.size());
+//     ...
+//     request_arena.reset();
+//   }
+//
+// Running out of memory throws std::bad_alloc, or aborts if exceptions are
+// disabled.
+class arena : private arena_detail::constants<> {
+
+	using chunk = arena_detail::chunk;
+
+	chunk * chunks_ = nullptr; // The current one first.
+	char * ptr_ = nullptr;
+	char * end_ = nullptr;
+	std::size_t next_size_;
+
+	static char * data(chunk * c) { return reinterpret_cast<char *>(c) + header_size; }
+
+	static chunk * new_chunk(std::size_t size, chunk * next) {
+		if (size > std::size_t(-1) - header_size) arena_detail::bad_alloc();
+		chunk * c = static_cast<chunk *>(std::malloc(header_size + size));
+		if (!c) arena_detail::bad_alloc();
+		c->next = next;
+		c->size = size;
+		return c;
+	}
+
+	void * allocate_slow(std::size_t size, std::size_t align) {
+		if (size > std::size_t(-1) - align) arena_detail::bad_alloc();
+		std::size_t need = size + align - 1;
+		if (need > next_size_ && chunks_) {
+			// Goes behind the current chunk, which is still used for what
+			// comes next.
+			chunk * c = new_chunk(need, chunks_->next);
+			chunks_->next = c;
+			std::uintptr_t p = reinterpret_cast<std::uintptr_t>(data(c));
+			return reinterpret_cast<void *>((p + align - 1) & ~std::uintptr_t(align - 1));
+		}
+		std::size_t s = next_size_;
+		if (s < need) {
+			s = need;
+		} else if (next_size_ < max_chunk_size) {
+			next_size_ *= 2;
+		}
+		chunks_ = new_chunk(s, chunks_);
+		ptr_ = data(chunks_);
+		end_ = ptr_ + s;
+		return allocate(size, align);
+	}
+
+	void free_chunks() noexcept {
+		for (chunk * c = chunks_; c;) {
+			chunk * next = c->next;
+			std::free(c);
+			c = next;
+		}
+	}
+
+public:
+	explicit arena(std::size_t first_chunk_size = 4096) noexcept
+		: next_size_(first_chunk_size ? first_chunk_size : 1) {}
+
+	arena(arena && other) noexcept
+		: chunks_(other.chunks_), ptr_(other.ptr_), end_(other.end_), next_size_(other.next_size_) {
+		other.chunks_ = nullptr;
+		other.ptr_ = other.end_ = nullptr;
+	}
+
+	arena(arena const &) = delete;
+	arena & operator = (arena const &) = delete;
+
+	~arena() { free_chunks(); }
+
+	// size bytes, aligned to align, which must be a power of two.
+	void * allocate(std::size_t size, std::size_t align = alignof(std::max_align_t)) {
+		std::uintptr_t p = (reinterpret_cast<std::uintptr_t>(ptr_) + align - 1) & ~std::uintptr_t(align - 1);
+		std::uintptr_t end = reinterpret_cast<std::uintptr_t>(end_);
+		if (!ptr_ || p > end || size > end - p) return allocate_slow(size, align);
+		ptr_ = reinterpret_cast<char *>(p + size);
+		return reinterpret_cast<void *>(p);
+	}
+
+	// n default-initialized T's. (That is, uninitialized for types like int.)
+	template<typename T>
+	range<T> allocate(std::size_t n) {
+		static_assert(std::is_trivially_destructible<T>::value, "an arena never runs destructors");
+		if (n == 0) return {};
+		if (n > std::size_t(-1) / sizeof(T)) arena_detail::bad_alloc();
+		T * p = static_cast<T *>(allocate(n * sizeof(T), alignof(T)));
+		for (std::size_t i = 0; i < n; ++i) ::new (static_cast<void *>(p + i)) T;
+		return {p, n};
+	}
+
+	template<typename T, typename... Args>
+	T * create(Args &&... args) {
+		static_assert(std::is_trivially_destructible<T>::value, "an arena never runs destructors");
+		return ::new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+	}
+
+	// Frees everything allocated so far, keeping the largest chunk to reuse.
+	void reset() noexcept {
+		if (!chunks_) return;
+		chunk * largest = chunks_;
+		for (chunk * c = chunks_->next; c; c = c->next) if (c->size > largest->size) largest = c;
+		for (chunk * c = chunks_; c;) {
+			chunk * next = c->next;
+			if (c != largest) std::free(c);
+			c = next;
+		}
+		largest->next = nullptr;
+		chunks_ = largest;
+		ptr_ = data(largest);
+		end_ = ptr_ + largest->size;
+	}
+};
+
+// An std::allocator-compatible allocator using an arena. Deallocating does
+// nothing: the memory is reclaimed by arena::reset().
+//
+// This can be used with allocate_refcount, for reference counted objects of
+// which the destructor runs when the last reference is gone, but of which the
+// memory is only reused after a reset. All references must be gone by then.
+template<typename T>
+struct arena_allocator {
+	using value_type = T;
+
+	explicit arena_allocator(arena & a) noexcept : arena_(&a) {}
+
+	template<typename U>
+	arena_allocator(arena_allocator<U> const & other) noexcept : arena_(&other.get_arena()) {}
+
+	T * allocate(std::size_t n) {
+		if (n > std::size_t(-1) / sizeof(T)) arena_detail::bad_alloc();
+		return static_cast<T *>(arena_->allocate(n * sizeof(T), alignof(T)));
+	}
+
+	void deallocate(T *, std::size_t) noexcept {}
+
+	arena & get_arena() const noexcept { return *arena_; }
+
+	template<typename U>
+	friend bool operator == (arena_allocator const & a, arena_allocator<U> const & b) noexcept { return a.arena_ == &b.get_arena(); }
+
+	template<typename U>
+	friend bool operator != (arena_allocator const & a, arena_allocator<U> const & b) noexcept { return a.arena_ != &b.get_arena(); }
+
+private:
+	arena * arena_;
+};
+
+#if __cpp_lib_memory_resource
+
+// An arena as std::pmr::memory_resource, for use with the std::pmr
+// containers. Deallocating does nothing.
+class arena_resource : public std::pmr::memory_resource {
+	arena * arena_;
+
+	void * do_allocate(std::size_t bytes, std::size_t alignment) override { return arena_->allocate(bytes, alignment); }
+
+	void do_deallocate(void *, std::size_t, std::size_t) override {}
+
+	bool do_is_equal(std::pmr::memory_resource const & other) const noexcept override { return this == &other; }
+
+public:
+	explicit arena_resource(arena & a) noexcept : arena_(&a) {}
+
+	arena & get_arena() const noexcept { return *arena_; }
+};
+
+#endif
+
+}
@@ -0,0 +1,245 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <type_traits>
+#include <utility>
+
+#include "refcount.hpp"
+
+namespace mstd {
+
+namespace atomic_refcount_ptr_detail {
+
+// Whether a reference counting policy is thread safe, which is what handoff()
+// marks.
+template<typename Policy, typename = void>
+struct is_thread_safe : std::false_type {};
+
+template<typename Policy>
+struct is_thread_safe<Policy, decltype(Policy::handoff(std::declval<typename Policy::counter &>()))> : std::true_type {};
+
+// Kept out of line, to keep it out of the code storing pointers.
+#if defined(__GNUC__) || defined(__clang__)
+__attribute__((noinline, cold))
+#endif
+[[noreturn]] inline void pointer_too_wide() noexcept {
+	std::fputs("mstd::atomic_refcount_ptr: pointer uses the highest 16 bits\n", stderr);
+	std::abort();
+}
+
+}
+
+// A refcount_ptr that can be loaded and replaced by multiple threads at once,
+// without locks.
+//
+// Example:
+//   mstd::atomic_refcount_ptr<Table const> current_table;
+//
+//   void reader() {
+//     mstd::refcount_ptr<Table const> table = current_table.load();
+//     ...
+//   }
+//
+//   void writer() {
+//     current_table.store(mstd::make_refcount<Table const>(...));
+//   }
+//
+// This uses split reference counts: next to the pointer, the atomic word keeps
+// a 'local' count of references that loads have borrowed from it. A load
+// borrows a reference with a single fetch_add on the word, which keeps the
+// object alive long enough to add a real reference to its reference count,
+// after which the borrowed reference is given back. Replacing the pointer
+// transfers all borrowed references that are still outstanding to the
+// object's reference count, so they can be given back there instead.
+//
+// The local count is kept in the highest 16 bits of the word, which requires
+// a 64-bit platform where those bits of a pointer are always zero (e.g. x86-64
+// and AArch64 with 48-bit virtual addresses). That is checked on every store
+// (also with NDEBUG), which aborts the program with a message on systems with
+// larger addresses, such as x86-64 with 5-level paging.
+//
+// The objects must have a thread safe reference count (not refcounted_local). Objects with a
+// biased_refcount are handed off when they are stored.
+template<typename T>
+class atomic_refcount_ptr {
+
+public:
+	using element_type = T;
+
+	using refcounted_type = typename refcount_ptr<T>::refcounted_type;
+
+private:
+	static_assert(sizeof(std::uintptr_t) == 8, "atomic_refcount_ptr needs 64-bit pointers");
+
+	static_assert(
+		atomic_refcount_ptr_detail::is_thread_safe<refcount_policy_of<refcounted_type>>::value,
+		"atomic_refcount_ptr needs objects with a thread safe reference count, not refcounted_local"
+	);
+
+	static constexpr int local_shift = 48;
+
+	// One borrowed reference in the local count.
+	static constexpr std::uintptr_t one = std::uintptr_t(1) << local_shift;
+
+	static constexpr std::uintptr_t pointer_mask = one - 1;
+
+	// More than the local count can ever hold.
+	static constexpr std::size_t max_local = std::size_t(1) << (64 - local_shift);
+
+	mutable std::atomic<std::uintptr_t> word;
+
+	static refcounted_type * pointer(std::uintptr_t w) noexcept {
+		return reinterpret_cast<refcounted_type *>(w & pointer_mask);
+	}
+
+	static std::size_t local(std::uintptr_t w) noexcept {
+		return w >> local_shift;
+	}
+
+	static std::uintptr_t pack(refcounted_type * object) noexcept {
+		auto w = reinterpret_cast<std::uintptr_t>(object);
+		if (w & ~pointer_mask) atomic_refcount_ptr_detail::pointer_too_wide();
+		return w;
+	}
+
+	static refcounted_type * take(refcount_ptr<T> & p) noexcept {
+		p.handoff();
+		refcounted_type * object = p.object;
+		p.object = nullptr;
+		return object;
+	}
+
+	static refcount_ptr<T> adopt(refcounted_type * object) noexcept {
+		refcount_ptr<T> p;
+		p.object = object;
+		return p;
+	}
+
+	// Borrows a reference to the current object.
+	// Returns the word, including the borrowed reference.
+	std::uintptr_t borrow() const noexcept {
+		return word.fetch_add(one, std::memory_order_acquire) + one;
+	}
+
+	// Gives back a reference borrowed from w. If the pointer was replaced in
+	// the meantime, it was transferred to the object's reference count.
+	// The caller must have added a reference of its own first, so that one
+	// is never the last.
+	void give_back(std::uintptr_t w) const noexcept {
+		refcounted_type * object = pointer(w);
+		while (pointer(w) == object && local(w) > 0) {
+			if (word.compare_exchange_weak(w, w - one, std::memory_order_relaxed)) return;
+		}
+		if (object) refcount_detail::access::drop_not_last<refcount_policy_of<refcounted_type>>(object);
+	}
+
+	// Replaces the object by desired, if it is still the one from w, which
+	// includes a borrowed reference. On success, the reference that was held
+	// by this atomic_refcount_ptr is passed on to the caller.
+	//
+	// Before the borrowed references are known, more references than could
+	// ever have been borrowed are added to the object, such that concurrent
+	// loads which find that their borrowed references were transferred can
+	// safely drop them.
+	//
+	// The extra references are reserved, such that instrumentation does not
+	// count them as references, only the transferred ones.
+	bool replace(std::uintptr_t w, refcounted_type * desired) noexcept {
+		using policy = refcount_policy_of<refcounted_type>;
+		refcounted_type * object = pointer(w);
+		if (object) refcount_detail::access::reserve(object, max_local);
+		do {
+			if (word.compare_exchange_weak(w, pack(desired), std::memory_order_acq_rel, std::memory_order_relaxed)) {
+				// Keep the transferred references, except our own.
+				if (object) {
+#if MSTD_INSTRUMENT
+					if (local(w)) instrument_detail::on_increment<refcounted_type>(object, local(w), 0);
+#endif
+					refcount_detail::access::drop<policy>(object, 1, max_local - local(w));
+				}
+				return true;
+			}
+		} while (pointer(w) == object);
+		// Someone else replaced it, and transferred our borrowed reference.
+		if (object) refcount_detail::access::drop<policy>(object, 1, max_local);
+		return false;
+	}
+
+public:
+	atomic_refcount_ptr() noexcept : word(0) {}
+
+	atomic_refcount_ptr(std::nullptr_t) noexcept : word(0) {}
+
+	atomic_refcount_ptr(refcount_ptr<T> p) noexcept : word(pack(take(p))) {}
+
+	atomic_refcount_ptr(atomic_refcount_ptr const &) = delete;
+	atomic_refcount_ptr & operator=(atomic_refcount_ptr const &) = delete;
+
+	~atomic_refcount_ptr() noexcept {
+		std::uintptr_t w = word.load(std::memory_order_relaxed);
+		assert(local(w) == 0);
+		if (pointer(w)) decrement_refcount(pointer(w));
+	}
+
+	bool is_lock_free() const noexcept {
+		return word.is_lock_free();
+	}
+
+	refcount_ptr<T> load() const noexcept {
+		std::uintptr_t w = borrow();
+		refcounted_type * object = pointer(w);
+		if (object) increment_refcount(object);
+		give_back(w);
+		return adopt(object);
+	}
+
+	operator refcount_ptr<T>() const noexcept {
+		return load();
+	}
+
+	refcount_ptr<T> exchange(refcount_ptr<T> desired) noexcept {
+		refcounted_type * d = take(desired);
+		for (;;) {
+			std::uintptr_t w = borrow();
+			if (replace(w, d)) return adopt(pointer(w));
+		}
+	}
+
+	void store(refcount_ptr<T> desired) noexcept {
+		exchange(std::move(desired));
+	}
+
+	atomic_refcount_ptr & operator=(refcount_ptr<T> desired) noexcept {
+		store(std::move(desired));
+		return *this;
+	}
+
+	// Replaces the object by desired if it is the one expected points to.
+	// Otherwise, expected is set to the current object.
+	bool compare_exchange(refcount_ptr<T> & expected, refcount_ptr<T> desired) noexcept {
+		desired.handoff();
+		for (;;) {
+			std::uintptr_t w = borrow();
+			refcounted_type * object = pointer(w);
+			if (object != expected.object) {
+				if (object) increment_refcount(object);
+				give_back(w);
+				expected = adopt(object);
+				return false;
+			}
+			if (replace(w, desired.object)) {
+				desired.object = nullptr;
+				if (object) decrement_refcount(object);
+				return true;
+			}
+		}
+	}
+
+};
+
+}
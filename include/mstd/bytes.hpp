@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "range.hpp"
+
+namespace mstd {
+
+// std::byte, or an equivalent type before C++17.
+#if __cpp_lib_byte
+using std::byte;
+#else
+enum class byte : unsigned char {};
+#endif
+
+namespace bytes_detail {
+
+template<typename T, std::size_t Extent>
+struct byte_extent : std::integral_constant<std::size_t, Extent * sizeof(T)> {};
+
+template<typename T>
+struct byte_extent<T, dynamic_extent> : std::integral_constant<std::size_t, dynamic_extent> {};
+
+// Only an alignment stronger than that of T is kept, such that the bytes of a
+// plain range<T> are a plain range<byte>.
+template<typename T, std::size_t Align>
+struct byte_alignment : std::integral_constant<std::size_t, (Align > alignof(T) ? Align : 0)> {};
+
+template<typename T, std::size_t Extent, std::size_t Align>
+using bytes_of = range<
+	typename std::conditional<std::is_const<T>::value, byte const, byte>::type,
+	byte_extent<T, Extent>::value,
+	byte_alignment<T, Align>::value
+>;
+
+}
+
+// The bytes of the elements of r, without copying them.
+// A fixed extent and an alignment stronger than that of T are kept.
+template<typename T, std::size_t Extent, std::size_t Align>
+bytes_detail::bytes_of<T const, Extent, Align> as_bytes(range<T, Extent, Align> r) {
+	return {reinterpret_cast<byte const *>(r.data()), r.size() * sizeof(T)};
+}
+
+template<
+	typename T,
+	std::size_t Extent,
+	std::size_t Align,
+	typename = std::enable_if_t<!std::is_const<T>::value>
+>
+bytes_detail::bytes_of<T, Extent, Align> as_writable_bytes(range<T, Extent, Align> r) {
+	return {reinterpret_cast<byte *>(r.data()), r.size() * sizeof(T)};
+}
+
+// Whether range_cast<U>(r) is valid: whether r is aligned for U, and
+// consists of a whole number of U's.
+template<typename U, typename B, std::size_t Extent, std::size_t Align>
+bool can_range_cast(range<B, Extent, Align> r) {
+	static_assert(std::is_same<typename std::remove_const<B>::type, byte>::value, "range_cast casts from a range of bytes");
+	return reinterpret_cast<std::uintptr_t>(r.data()) % alignof(U) == 0 && r.size() % sizeof(U) == 0;
+}
+
+// The bytes r, interpreted as an array of U's, without copying them. For
+// example, for reading a file or message in a known binary format.
+//
+// U must be trivially copyable, and const if the bytes are. The bytes must be
+// aligned for U, and their number a multiple of sizeof(U), which is asserted.
+// Use can_range_cast<U>(r) to check this first, for bytes from an untrusted
+// source.
+template<typename U, typename B, std::size_t Extent, std::size_t Align>
+range<U> range_cast(range<B, Extent, Align> r) {
+	static_assert(std::is_trivially_copyable<U>::value, "range_cast can only be used for trivially copyable types");
+	static_assert(std::is_const<U>::value || !std::is_const<B>::value, "range_cast would cast away const");
+	assert(can_range_cast<U>(r));
+	return {reinterpret_cast<U *>(r.data()), r.size() / sizeof(U)};
+}
+
+}
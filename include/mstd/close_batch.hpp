@@ -0,0 +1,188 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+#endif
+
+#include "range.hpp"
+#include "unique.hpp"
+
+namespace mstd {
+
+// A Closer for unique<T, Closer> can have a close_batch(range<T>) member, to
+// close many values at once more cheaply than one by one. It may reorder the
+// values in the range. close_batch() and close_all() use it when available.
+
+namespace close_batch_detail {
+
+template<typename Closer, typename T, typename = void>
+struct has_close_batch : std::false_type {};
+
+template<typename Closer, typename T>
+struct has_close_batch<Closer, T, decltype(void(std::declval<Closer &>().close_batch(std::declval<range<T>>())))> : std::true_type {};
+
+template<typename Closer, typename T>
+void close_batch(Closer & closer, range<T> values, std::true_type) {
+	closer.close_batch(values);
+}
+
+template<typename Closer, typename T>
+void close_batch(Closer & closer, range<T> values, std::false_type) {
+	for (T & v : values) closer(v);
+}
+
+}
+
+// Closes all values with closer, using closer.close_batch() if it exists, or
+// closer(v) for every value otherwise.
+template<typename Closer, typename T>
+void close_batch(Closer & closer, range<T> values) {
+	close_batch_detail::close_batch(closer, values, close_batch_detail::has_close_batch<Closer, T>());
+}
+
+namespace close_batch_detail {
+
+template<typename Closer, typename = void>
+struct is_equality_comparable : std::false_type {};
+
+template<typename Closer>
+struct is_equality_comparable<Closer, decltype(void(bool(std::declval<Closer const &>() == std::declval<Closer const &>())))> : std::true_type {};
+
+// Whether values of two handles can be closed by either of their closers:
+// always for closers without state, and otherwise if they compare equal.
+template<typename Closer>
+bool same_closer(Closer const &, Closer const &, std::true_type /* empty */) { return true; }
+
+template<typename Closer>
+bool same_closer(Closer const & a, Closer const & b, std::false_type /* empty */) { return a == b; }
+
+template<typename T, typename Closer>
+void close_all(range<unique<T, Closer>> handles, std::false_type /* batched */) {
+	for (auto & h : handles) h.reset();
+}
+
+template<typename T, typename Closer>
+void close_all(range<unique<T, Closer>> handles, std::true_type /* batched */) {
+	constexpr std::size_t batch_size = 64;
+	T batch[batch_size];
+	std::size_t n = 0;
+	Closer * closer = nullptr;
+	for (auto & h : handles) {
+		if (!h) continue;
+		if (n == batch_size || (n && !same_closer(*closer, h.closer(), std::is_empty<Closer>()))) {
+			mstd::close_batch(*closer, range<T>(batch, n));
+			n = 0;
+		}
+		if (n == 0) closer = &h.closer();
+		batch[n++] = h.release();
+	}
+	if (n) mstd::close_batch(*closer, range<T>(batch, n));
+}
+
+}
+
+// Closes all handles, leaving them empty.
+//
+// If Closer has close_batch(), the values of adjacent handles with the same
+// closer are closed in batches. Closers without state are always the same,
+// and others are compared with ==. Closers with state but without == close
+// every value by itself.
+template<typename T, typename Closer>
+void close_all(range<unique<T, Closer>> handles) {
+	close_batch_detail::close_all(handles, std::integral_constant<bool,
+		close_batch_detail::has_close_batch<Closer, T>::value &&
+		(std::is_empty<Closer>::value || close_batch_detail::is_equality_comparable<Closer>::value)
+	>());
+}
+
+// A Closer that doesn't close the value right away, but adds it to a queue
+// for the current thread. The queue is closed with Closer::close_batch() (or
+// one by one) when it holds BatchSize values, when flush() is called, and when
+// the thread exits.
+//
+// This makes destroying many handles at once, for example when thousands of
+// connections drop, cost a few calls instead of one per handle. The values are
+// only closed later, so the resources stay in use until the queue is flushed.
+//
+// Closer must be default constructible, and is constructed for every batch.
+//
+// Example:
+//   using socket_handle = mstd::unique<int, mstd::deferred_close<int, mstd::fd_closer>>;
+template<typename T, typename Closer, std::size_t BatchSize = 256>
+struct deferred_close {
+
+	void operator () (T & value) const {
+		auto & q = queue();
+		q.values.push_back(std::move(value));
+		if (q.values.size() >= BatchSize) q.flush();
+	}
+
+	// Closes everything queued by the current thread.
+	static void flush() { queue().flush(); }
+
+	// The number of values queued by the current thread.
+	static std::size_t queued() { return queue().values.size(); }
+
+private:
+	struct queue_type {
+		std::vector<T> values;
+
+		void flush() {
+			if (values.empty()) return;
+			Closer closer;
+			close_batch(closer, range<T>(values.data(), values.size()));
+			values.clear();
+		}
+
+		~queue_type() { flush(); }
+	};
+
+	static queue_type & queue() {
+		static thread_local queue_type q;
+		return q;
+	}
+};
+
+#if defined(__unix__) || defined(__APPLE__)
+
+// Closes file descriptors.
+//
+// close_batch() sorts the descriptors, and closes every run of consecutive
+// ones with a single close_range() system call, where available (Linux 5.9).
+//
+// Note that unique<int, fd_closer> will not close descriptor 0, since that's
+// also its empty value.
+struct fd_closer {
+	void operator () (int fd) const { ::close(fd); }
+
+	void close_batch(range<int> fds) const {
+		std::sort(fds.begin(), fds.end());
+		for (std::size_t i = 0; i < fds.size();) {
+			std::size_t j = i + 1;
+			while (j < fds.size() && fds[j] - fds[j - 1] <= 1) ++j;
+			close_run(fds[i], fds[j - 1]);
+			i = j;
+		}
+	}
+
+private:
+	static void close_run(int first, int last) {
+#if defined(__linux__) && defined(SYS_close_range)
+		if (last > first && syscall(SYS_close_range, unsigned(first), unsigned(last), 0u) == 0) return;
+#endif
+		for (int fd = first; fd <= last; ++fd) ::close(fd);
+	}
+};
+
+#endif
+
+}
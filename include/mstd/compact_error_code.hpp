@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+
+namespace mstd {
+
+// An error code like std::error_code, but in 8 bytes instead of 16.
+//
+// Instead of a pointer to the category, it stores a 32-bit index in a table
+// of categories, to which a category is added the first time it is used.
+// That way, error_or<int, compact_error_code> and
+// error_or<T *, compact_error_code> are small enough to be returned in
+// registers.
+//
+// Converts implicitly from and to std::error_code.
+//
+// At most compact_error_code::max_categories different categories can be
+// used. Using more throws std::length_error, or aborts if exceptions are
+// disabled.
+class compact_error_code {
+
+public:
+	static constexpr std::size_t max_categories = 256;
+
+private:
+	int value_;
+	std::uint32_t category_;
+
+	// Index 0 is always the system category, such that a value-initialized
+	// compact_error_code is the same as a value-initialized std::error_code.
+	static std::atomic<std::error_category const *> * categories() noexcept {
+		static std::atomic<std::error_category const *> table[max_categories];
+		return table;
+	}
+
+	static std::uint32_t index_of(std::error_category const & category) {
+		if (category == std::system_category()) return 0;
+		std::atomic<std::error_category const *> * table = categories();
+		for (std::uint32_t i = 1; i < max_categories; ++i) {
+			std::error_category const * c = table[i].load(std::memory_order_acquire);
+			if (!c && table[i].compare_exchange_strong(c, &category, std::memory_order_acq_rel)) return i;
+			if (*c == category) return i;
+		}
+#if defined(__cpp_exceptions) || defined(__EXCEPTIONS) || defined(_CPPUNWIND)
+		throw std::length_error("compact_error_code: too many error categories");
+#else
+		std::abort();
+#endif
+	}
+
+public:
+	compact_error_code() noexcept : value_(0), category_(0) {}
+
+	compact_error_code(int value, std::error_category const & category)
+		: value_(value), category_(index_of(category)) {}
+
+	compact_error_code(std::error_code const & e)
+		: compact_error_code(e.value(), e.category()) {}
+
+	template<
+		typename E,
+		typename = typename std::enable_if<std::is_error_code_enum<E>::value>::type
+	>
+	compact_error_code(E e) : compact_error_code(std::error_code(make_error_code(e))) {}
+
+	int value() const noexcept { return value_; }
+
+	std::error_category const & category() const noexcept {
+		if (category_ == 0) return std::system_category();
+		return *categories()[category_].load(std::memory_order_relaxed);
+	}
+
+	std::string message() const { return category().message(value_); }
+
+	std::error_code code() const noexcept { return std::error_code(value_, category()); }
+
+	operator std::error_code() const noexcept { return code(); }
+
+	explicit operator bool() const noexcept { return value_ != 0; }
+
+	friend bool operator == (compact_error_code a, compact_error_code b) noexcept {
+		return a.value_ == b.value_ && a.category_ == b.category_;
+	}
+
+	friend bool operator != (compact_error_code a, compact_error_code b) noexcept {
+		return !(a == b);
+	}
+
+	friend bool operator == (compact_error_code a, std::error_code const & b) noexcept {
+		return a.code() == b;
+	}
+
+	friend bool operator != (compact_error_code a, std::error_code const & b) noexcept {
+		return a.code() != b;
+	}
+
+	friend bool operator == (std::error_code const & a, compact_error_code b) noexcept {
+		return a == b.code();
+	}
+
+	friend bool operator != (std::error_code const & a, compact_error_code b) noexcept {
+		return a != b.code();
+	}
+};
+
+static_assert(sizeof(compact_error_code) == 8, "compact_error_code should be 8 bytes");
+
+}
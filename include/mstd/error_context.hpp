@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <system_error>
+#include <type_traits>
+
+#include "range.hpp"
+
+namespace mstd {
+
+// A std::error_code with a few strings describing what was going on when the
+// error happened, for use as Error in error_or<T, Error>.
+//
+// The strings are not copied, only pointers to them are stored, so they
+// must live forever (e.g. string literals). That way, adding context never
+// allocates, and error_context stays trivially copyable.
+//
+// Example:
+//   mstd::error_or<Config, mstd::error_context> load_config() {
+//     mstd::error_or<std::string, mstd::error_context> file = read_file("config.json");
+//     if (!file) return file.error().with("reading the configuration");
+//     ...
+//   }
+//
+//   load_config().error().message() // "reading the configuration: No such file or directory"
+//
+// Only the first max_context strings are kept. More are ignored.
+class error_context {
+
+public:
+	static constexpr std::size_t max_context = 4;
+
+private:
+	std::error_code code_;
+
+	// The innermost context first. Unused entries are null.
+	char const * context_[max_context];
+
+public:
+	error_context() noexcept : code_(), context_{} {}
+
+	error_context(std::error_code code) noexcept : code_(code), context_{} {}
+
+	template<
+		typename E,
+		typename = typename std::enable_if<std::is_error_code_enum<E>::value>::type
+	>
+	error_context(E e) noexcept : error_context(std::error_code(make_error_code(e))) {}
+
+	// Adds context, describing what was being done when this error happened.
+	error_context & add(char const * context) noexcept {
+		for (auto & c : context_) {
+			if (!c) {
+				c = context;
+				break;
+			}
+		}
+		return *this;
+	}
+
+	error_context with(char const * context) const noexcept {
+		error_context e = *this;
+		e.add(context);
+		return e;
+	}
+
+	std::error_code const & code() const noexcept { return code_; }
+
+	operator std::error_code const & () const noexcept { return code_; }
+
+	int value() const noexcept { return code_.value(); }
+
+	std::error_category const & category() const noexcept { return code_.category(); }
+
+	// The contexts, the innermost first.
+	range<char const * const> context() const noexcept {
+		std::size_t n = 0;
+		while (n < max_context && context_[n]) ++n;
+		return {context_, n};
+	}
+
+	// The contexts, the outermost first, followed by the message of the error
+	// code, separated by ": ".
+	std::string message() const {
+		std::string result;
+		auto c = context();
+		for (std::size_t i = c.size(); i > 0; --i) {
+			result += c[i - 1];
+			result += ": ";
+		}
+		result += code_.message();
+		return result;
+	}
+
+	explicit operator bool() const noexcept { return bool(code_); }
+
+	// Compares only the error codes, not the context.
+
+	friend bool operator == (error_context const & a, error_context const & b) noexcept {
+		return a.code_ == b.code_;
+	}
+
+	friend bool operator != (error_context const & a, error_context const & b) noexcept {
+		return a.code_ != b.code_;
+	}
+
+	friend bool operator == (error_context const & a, std::error_code const & b) noexcept {
+		return a.code_ == b;
+	}
+
+	friend bool operator != (error_context const & a, std::error_code const & b) noexcept {
+		return a.code_ != b;
+	}
+
+	friend bool operator == (std::error_code const & a, error_context const & b) noexcept {
+		return a == b.code_;
+	}
+
+	friend bool operator != (std::error_code const & a, error_context const & b) noexcept {
+		return a != b.code_;
+	}
+};
+
+static_assert(std::is_trivially_copyable<error_context>::value, "error_context should be trivially copyable");
+
+}
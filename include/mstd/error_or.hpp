@@ -1,11 +1,52 @@
 #pragma once
 
+#include <cassert>
 #include <new>
 #include <stdexcept>
 #include <system_error>
 #include <type_traits>
 #include <utility>
 
+#include "instrument.hpp"
+
+// How error_or(Error) checks that it didn't get a 'no error' value:
+//
+//   MSTD_ERROR_OR_CHECK_THROW:  Throw std::invalid_argument.
+//                               The default if exceptions are enabled.
+//   MSTD_ERROR_OR_CHECK_ASSERT: assert() it. The default otherwise.
+//   MSTD_ERROR_OR_CHECK_NONE:   Don't check it.
+//
+// To choose one, define MSTD_ERROR_OR_CHECK to one of them before including
+// this header.
+#define MSTD_ERROR_OR_CHECK_NONE   0
+#define MSTD_ERROR_OR_CHECK_ASSERT 1
+#define MSTD_ERROR_OR_CHECK_THROW  2
+
+#ifndef MSTD_ERROR_OR_CHECK
+#if defined(__cpp_exceptions) || defined(__EXCEPTIONS) || defined(_CPPUNWIND)
+#define MSTD_ERROR_OR_CHECK MSTD_ERROR_OR_CHECK_THROW
+#else
+#define MSTD_ERROR_OR_CHECK MSTD_ERROR_OR_CHECK_ASSERT
+#endif
+#endif
+
+// Branch prediction hints. Each can be defined separately to override it.
+#ifndef MSTD_LIKELY
+#if defined(__GNUC__) || defined(__clang__)
+#define MSTD_LIKELY(x)   __builtin_expect(!!(x), 1)
+#else
+#define MSTD_LIKELY(x)   (x)
+#endif
+#endif
+
+#ifndef MSTD_UNLIKELY
+#if defined(__GNUC__) || defined(__clang__)
+#define MSTD_UNLIKELY(x) __builtin_expect(!!(x), 0)
+#else
+#define MSTD_UNLIKELY(x) (x)
+#endif
+#endif
+
 namespace mstd {
 
 // error_or<T> represents either a T or an error.
@@ -31,6 +72,8 @@ namespace mstd {
 //
 // By default, std::error_code is used for errors, but an anternative error
 // type can be given as the second template argument: error_or<T, Error>
+// (See compact_error_code.hpp for a std::error_code replacement of half its
+// size.)
 //
 // Error must be able to represent 'no error', and must value-initialize to a
 // 'no error' value.
@@ -57,7 +100,8 @@ namespace mstd {
 // error_or<T, Error> can be implicitly constructed from either a T or an
 // Error. The only restriction is that the Error must not be a 'no error'
 // value, since in that case, there should've been a value. The specialization
-// for T=void doesn't have this restriction.
+// for T=void doesn't have this restriction. (See MSTD_ERROR_OR_CHECK above for
+// how this is checked, and unchecked_error to skip the check.)
 //
 // Example:
 //   mstd::error_or<std::string, ErrorCode> get_something() {
@@ -71,123 +115,388 @@ namespace mstd {
 //     }
 //   }
 
+// Tag to construct an error_or from an Error without checking that it is not a
+// 'no error' value. It is undefined behaviour if it is.
+struct unchecked_error_t { explicit unchecked_error_t() = default; };
+constexpr unchecked_error_t unchecked_error{};
+
+// Tag to construct the value of an error_or in place, from the given arguments.
+struct in_place_t { explicit in_place_t() = default; };
+constexpr in_place_t in_place{};
+
+template<typename T, typename Error, typename ErrorIsOk> class error_or;
+
 namespace detail_ {
 
+#if MSTD_ERROR_OR_CHECK == MSTD_ERROR_OR_CHECK_THROW
+// Kept out of line, to keep the exception out of the code constructing errors.
+#if defined(__GNUC__) || defined(__clang__)
+__attribute__((noinline, cold))
+#endif
+[[noreturn]] inline void throw_error_or_without_error() {
+	throw std::invalid_argument("error_or(Error)");
+}
+#endif
+
 struct error_is_ok {
 	template<typename E>
-	bool operator () (E const & e) {
+	constexpr bool operator () (E const & e) const {
 		return !bool(e);
 	}
 };
 
-}
+template<typename F, typename... Args>
+using invoke_result = decltype(std::declval<F>()(std::declval<Args>()...));
+
+struct invoke_t {};
 
+template<typename T>
+struct error_or_value {
+	T value_;
+
+	template<typename... Args>
+	constexpr explicit error_or_value(in_place_t, Args &&... args)
+		noexcept(std::is_nothrow_constructible<T, Args &&...>::value)
+		: value_(std::forward<Args>(args)...) {}
+
+	// Directly initializes the value from the result of f(args...).
+	template<typename F, typename... Args>
+	constexpr error_or_value(invoke_t, F && f, Args &&... args) : value_(std::forward<F>(f)(std::forward<Args>(args)...)) {}
+};
+
+// Makes the result of error_or::transform(): an error_or<U> with the result
+// of f(args...) as its value.
+template<typename U, typename Error, typename ErrorIsOk>
+struct transformed {
+	template<typename F, typename... Args>
+	static constexpr error_or<U, Error, ErrorIsOk> make(F && f, Args &&... args) {
+		return error_or<U, Error, ErrorIsOk>(invoke_t{}, std::forward<F>(f), std::forward<Args>(args)...);
+	}
+};
+
+template<typename Error, typename ErrorIsOk>
+struct transformed<void, Error, ErrorIsOk> {
+	template<typename F, typename... Args>
+	static constexpr error_or<void, Error, ErrorIsOk> make(F && f, Args &&... args) {
+		std::forward<F>(f)(std::forward<Args>(args)...);
+		return error_or<void, Error, ErrorIsOk>();
+	}
+};
+
+// The members of error_or<T, Error>.
+// The destructor is trivial if those of T and Error are.
 template<
 	typename T,
-	typename Error = std::error_code,
-	typename ErrorIsOk = detail_::error_is_ok
+	typename Error,
+	typename ErrorIsOk,
+	bool = std::is_trivially_destructible<Error>::value &&
+		std::is_trivially_destructible<error_or_value<T>>::value
 >
-class error_or {
+struct error_or_storage {
+	using Value = error_or_value<T>;
 
 	Error error_;
 
-	struct Value { T value_; };
-	union { Value value_; };
+	// (no_value_ is only there because constexpr constructors need to
+	// initialize a member of the union.)
+	union {
+		char no_value_;
+		Value value_;
+	};
 
-public:
+	constexpr explicit error_or_storage(Error && e) : error_(std::move(e)), no_value_() {}
+	constexpr explicit error_or_storage(Error const & e) : error_(e), no_value_() {}
 
-	// Implicit conversions from both Error and T.
+	template<typename... Args>
+	constexpr explicit error_or_storage(in_place_t, Args &&... args)
+		: error_(), value_(in_place, std::forward<Args>(args)...) {}
 
-	error_or(Error e) : error_(std::move(e)) {
-		// An error_or<T> without an error needs a value.
-		if (ok()) throw std::invalid_argument("error_or(Error)");
-	}
+	template<typename F, typename... Args>
+	constexpr error_or_storage(invoke_t, F && f, Args &&... args)
+		: error_(), value_(invoke_t{}, std::forward<F>(f), std::forward<Args>(args)...) {}
+
+	constexpr bool ok() const { return ErrorIsOk()(error_); }
+};
+
+template<typename T, typename Error, typename ErrorIsOk>
+struct error_or_storage<T, Error, ErrorIsOk, false> {
+	using Value = error_or_value<T>;
+
+	Error error_;
+
+	union {
+		char no_value_;
+		Value value_;
+	};
 
-	error_or(T value) : error_() {
-		new (&value_) Value{static_cast<T &&>(value)};
+	constexpr explicit error_or_storage(Error && e) : error_(std::move(e)), no_value_() {}
+	constexpr explicit error_or_storage(Error const & e) : error_(e), no_value_() {}
+
+	template<typename... Args>
+	constexpr explicit error_or_storage(in_place_t, Args &&... args)
+		: error_(), value_(in_place, std::forward<Args>(args)...) {}
+
+	template<typename F, typename... Args>
+	constexpr error_or_storage(invoke_t, F && f, Args &&... args)
+		: error_(), value_(invoke_t{}, std::forward<F>(f), std::forward<Args>(args)...) {}
+
+	~error_or_storage() {
+		if (ok()) value_.~Value();
 	}
 
+	constexpr bool ok() const { return ErrorIsOk()(error_); }
+};
+
+// Adds the copy and move operations to error_or_storage.
+// They are all trivial if those of T and Error are, such that
+// error_or<T, Error> is trivially copyable if T and Error are.
+template<
+	typename T,
+	typename Error,
+	typename ErrorIsOk,
+	bool = std::is_trivially_copyable<Error>::value &&
+		std::is_trivially_copyable<error_or_value<T>>::value &&
+		std::is_trivially_copy_assignable<error_or_value<T>>::value &&
+		std::is_trivially_destructible<error_or_value<T>>::value
+>
+struct error_or_base : error_or_storage<T, Error, ErrorIsOk> {
+	using error_or_storage<T, Error, ErrorIsOk>::error_or_storage;
+};
+
+template<typename T, typename Error, typename ErrorIsOk>
+struct error_or_base<T, Error, ErrorIsOk, false> : error_or_storage<T, Error, ErrorIsOk> {
+	using storage = error_or_storage<T, Error, ErrorIsOk>;
+	using typename storage::Value;
+	using storage::error_;
+	using storage::value_;
+	using storage::ok;
+
+	using storage::storage;
+
 	// Move and copy constructors.
 
-	error_or(error_or && other) noexcept(
+	error_or_base(error_or_base && other) noexcept(
 		noexcept(Error(std::move(other.error_))) &&
-		noexcept(Value{static_cast<T &&>(other.value_.value_)})
-	) : error_(std::move(other.error_)) {
-		if (ok()) new (&value_) Value{static_cast<T &&>(other.value_.value_)};
+		noexcept(Value{in_place, static_cast<T &&>(other.value_.value_)})
+	) : storage(std::move(other.error_)) {
+		if (MSTD_LIKELY(ok())) new (&value_) Value{in_place, static_cast<T &&>(other.value_.value_)};
 	}
 
-	error_or(error_or const & other) : error_(other.error_) {
-		if (ok()) new (&value_) Value{other.value_};
+	error_or_base(error_or_base const & other) : storage(other.error_) {
+		if (MSTD_LIKELY(ok())) new (&value_) Value{other.value_};
 	}
 
 	// Move and copy assignment.
 
-	error_or & operator = (error_or && other) noexcept(
+	error_or_base & operator = (error_or_base && other) noexcept(
 		noexcept(value_.value_ = std::move(other.value_.value_)) &&
-		noexcept(Value{static_cast<T &&>(other.value_.value_)}) &&
+		noexcept(Value{in_place, static_cast<T &&>(other.value_.value_)}) &&
 		noexcept(error_ = std::move(other.error_))
 	) {
-		if (ok() && other.ok()) {
+		if (MSTD_LIKELY(ok() && other.ok())) {
 			value_.value_ = std::move(other.value_.value_);
 		} else if (ok()) {
 			value_.~Value();
 		} else if (other.ok()) {
-			new (&value_) Value{static_cast<T &&>(other.value_.value_)};
+			new (&value_) Value{in_place, static_cast<T &&>(other.value_.value_)};
 		}
 		error_ = std::move(other.error_);
 		return *this;
 	}
 
-	error_or & operator = (error_or const & other) {
-		if (ok() && other.ok()) {
+	error_or_base & operator = (error_or_base const & other) {
+		if (MSTD_LIKELY(ok() && other.ok())) {
 			value_.value_ = other.value_.value_;
 		} else if (ok()) {
 			value_.~Value();
 		} else if (other.ok()) {
-			new (&value_) Value{other.value_.value_};
+			new (&value_) Value{in_place, other.value_.value_};
 		}
 		error_ = other.error_;
 		return *this;
 	}
+};
 
-	// Destructor.
+}
 
-	~error_or() {
-		if (ok()) value_.~Value();
+template<
+	typename T,
+	typename Error = std::error_code,
+	typename ErrorIsOk = detail_::error_is_ok
+>
+class error_or : detail_::error_or_base<T, Error, ErrorIsOk> {
+
+	using base = detail_::error_or_base<T, Error, ErrorIsOk>;
+	using typename base::Value;
+	using base::error_;
+	using base::value_;
+
+public:
+
+	// Implicit conversions from both Error and T.
+
+	constexpr error_or(Error e) : base(std::move(e)) {
+		// An error_or<T> without an error needs a value.
+#if MSTD_ERROR_OR_CHECK == MSTD_ERROR_OR_CHECK_THROW
+		if (MSTD_UNLIKELY(ok())) detail_::throw_error_or_without_error();
+#elif MSTD_ERROR_OR_CHECK == MSTD_ERROR_OR_CHECK_ASSERT
+		assert(!ok() && "error_or(Error) needs an error");
+#endif
+#if MSTD_INSTRUMENT
+		if (!ok()) instrument_detail::on_error(error_);
+#endif
 	}
 
+	constexpr error_or(unchecked_error_t, Error e) : base(std::move(e)) {}
+
+	constexpr error_or(T value) : base(in_place, static_cast<T &&>(value)) {}
+
+	template<typename... Args>
+	constexpr explicit error_or(in_place_t, Args &&... args) : base(in_place, std::forward<Args>(args)...) {}
+
+	// Used by transform().
+	template<typename F, typename... Args>
+	constexpr error_or(detail_::invoke_t, F && f, Args &&... args)
+		: base(detail_::invoke_t{}, std::forward<F>(f), std::forward<Args>(args)...) {}
+
+	// Copy, move and destruction come from error_or_base and error_or_storage,
+	// which make them trivial if they are for both T and Error.
+
 	// Explicit accessors.
 
-	bool ok() const { return ErrorIsOk()(error_); }
+	using base::ok;
 
-	Error       &  error()       &  { return error_; }
-	Error const &  error() const &  { return error_; }
-	Error       && error()       && { return std::move(error_); }
+	constexpr Error       &  error()       &  { return error_; }
+	constexpr Error const &  error() const &  { return error_; }
+	constexpr Error       && error()       && { return std::move(error_); }
 
-	T       &  value()       &  { return value_.value_; }
-	T const &  value() const &  { return value_.value_; }
-	T       && value()       && { return static_cast<T &&>(value_.value_); }
+	constexpr T       &  value()       &  { return value_.value_; }
+	constexpr T const &  value() const &  { return value_.value_; }
+	constexpr T       && value()       && { return static_cast<T &&>(value_.value_); }
 
 	template<typename U>
-	T value_or(U && default_value) const & {
+	constexpr T value_or(U && default_value) const & {
 		return ok() ? value_.value_ : static_cast<T>(std::forward<U>(default_value));
 	}
 
 	template<typename U>
-	T value_or(U && default_value) && {
+	constexpr T value_or(U && default_value) && {
 		return ok() ? static_cast<T &&>(value_.value_) : static_cast<T>(std::forward<U>(default_value));
 	}
 
 	// Implicit accessors.
 
-	explicit operator bool() const { return ok(); }
+	constexpr explicit operator bool() const { return ok(); }
+
+	constexpr T       &  operator * ()       &  { return value_.value_; }
+	constexpr T const &  operator * () const &  { return value_.value_; }
+	constexpr T       && operator * ()       && { return static_cast<T &&>(value_.value_); }
+
+	constexpr typename std::remove_reference<T>::type       * operator -> ()       { return &value_.value_; }
+	constexpr typename std::remove_reference<T>::type const * operator -> () const { return &value_.value_; }
+
+	// Monadic operations, like those of std::expected.
+	//
+	// and_then(f) gives f(value()) if ok(), or the error otherwise.
+	// f must return an error_or with the same Error.
+	//
+	// transform(f) gives an error_or with f(value()) as value if ok(), or the
+	// error otherwise. The new value is constructed in place.
+	//
+	// transform_error(f) gives an error_or with f(error()) as error if !ok(),
+	// or the value otherwise.
+	//
+	// or_else(f) gives f(error()) if !ok(), or the value otherwise.
+	// f must return an error_or with the same T.
+	//
+	// Example:
+	//   mstd::error_or<Config> c = read_file(path)
+	//     .and_then(parse_json)
+	//     .transform([] (Json const & j) { return Config(j); });
+
+	template<typename F>
+	constexpr detail_::invoke_result<F, T &> and_then(F && f) & {
+		using R = detail_::invoke_result<F, T &>;
+		if (ok()) return std::forward<F>(f)(value_.value_);
+		return R(unchecked_error, error_);
+	}
 
-	T       &  operator * ()       &  { return value_.value_; }
-	T const &  operator * () const &  { return value_.value_; }
-	T       && operator * ()       && { return static_cast<T &&>(value_.value_); }
+	template<typename F>
+	constexpr detail_::invoke_result<F, T const &> and_then(F && f) const & {
+		using R = detail_::invoke_result<F, T const &>;
+		if (ok()) return std::forward<F>(f)(value_.value_);
+		return R(unchecked_error, error_);
+	}
+
+	template<typename F>
+	constexpr detail_::invoke_result<F, T &&> and_then(F && f) && {
+		using R = detail_::invoke_result<F, T &&>;
+		if (ok()) return std::forward<F>(f)(static_cast<T &&>(value_.value_));
+		return R(unchecked_error, std::move(error_));
+	}
 
-	typename std::remove_reference<T>::type       * operator -> ()       { return &value_.value_; }
-	typename std::remove_reference<T>::type const * operator -> () const { return &value_.value_; }
+	template<typename F>
+	constexpr error_or<detail_::invoke_result<F, T &>, Error, ErrorIsOk> transform(F && f) & {
+		using U = detail_::invoke_result<F, T &>;
+		if (ok()) return detail_::transformed<U, Error, ErrorIsOk>::make(std::forward<F>(f), value_.value_);
+		return error_or<U, Error, ErrorIsOk>(unchecked_error, error_);
+	}
+
+	template<typename F>
+	constexpr error_or<detail_::invoke_result<F, T const &>, Error, ErrorIsOk> transform(F && f) const & {
+		using U = detail_::invoke_result<F, T const &>;
+		if (ok()) return detail_::transformed<U, Error, ErrorIsOk>::make(std::forward<F>(f), value_.value_);
+		return error_or<U, Error, ErrorIsOk>(unchecked_error, error_);
+	}
+
+	template<typename F>
+	constexpr error_or<detail_::invoke_result<F, T &&>, Error, ErrorIsOk> transform(F && f) && {
+		using U = detail_::invoke_result<F, T &&>;
+		if (ok()) return detail_::transformed<U, Error, ErrorIsOk>::make(std::forward<F>(f), static_cast<T &&>(value_.value_));
+		return error_or<U, Error, ErrorIsOk>(unchecked_error, std::move(error_));
+	}
+
+	template<typename F>
+	constexpr error_or<T, detail_::invoke_result<F, Error &>, ErrorIsOk> transform_error(F && f) & {
+		using R = error_or<T, detail_::invoke_result<F, Error &>, ErrorIsOk>;
+		if (ok()) return R(in_place, value_.value_);
+		return R(std::forward<F>(f)(error_));
+	}
+
+	template<typename F>
+	constexpr error_or<T, detail_::invoke_result<F, Error const &>, ErrorIsOk> transform_error(F && f) const & {
+		using R = error_or<T, detail_::invoke_result<F, Error const &>, ErrorIsOk>;
+		if (ok()) return R(in_place, value_.value_);
+		return R(std::forward<F>(f)(error_));
+	}
+
+	template<typename F>
+	constexpr error_or<T, detail_::invoke_result<F, Error &&>, ErrorIsOk> transform_error(F && f) && {
+		using R = error_or<T, detail_::invoke_result<F, Error &&>, ErrorIsOk>;
+		if (ok()) return R(in_place, static_cast<T &&>(value_.value_));
+		return R(std::forward<F>(f)(std::move(error_)));
+	}
+
+	template<typename F>
+	constexpr detail_::invoke_result<F, Error &> or_else(F && f) & {
+		using R = detail_::invoke_result<F, Error &>;
+		if (ok()) return R(in_place, value_.value_);
+		return std::forward<F>(f)(error_);
+	}
+
+	template<typename F>
+	constexpr detail_::invoke_result<F, Error const &> or_else(F && f) const & {
+		using R = detail_::invoke_result<F, Error const &>;
+		if (ok()) return R(in_place, value_.value_);
+		return std::forward<F>(f)(error_);
+	}
+
+	template<typename F>
+	constexpr detail_::invoke_result<F, Error &&> or_else(F && f) && {
+		using R = detail_::invoke_result<F, Error &&>;
+		if (ok()) return R(in_place, static_cast<T &&>(value_.value_));
+		return std::forward<F>(f)(std::move(error_));
+	}
 
 };
 
@@ -197,64 +506,125 @@ class error_or<void, Error, ErrorIsOk> {
 	Error error_;
 
 public:
-	error_or(Error e) : error_(std::move(e)) {}
+	constexpr error_or(Error e) : error_(std::move(e)) {
+#if MSTD_INSTRUMENT
+		if (!ok()) instrument_detail::on_error(error_);
+#endif
+	}
+
+	constexpr error_or(unchecked_error_t, Error e) : error_(std::move(e)) {}
+
+	constexpr error_or() : error_() {}
+
+	constexpr bool ok() const { return ErrorIsOk()(error_); }
+
+	constexpr explicit operator bool() const { return ok(); }
+
+	constexpr Error       &  error()       &  { return error_; }
+	constexpr Error const &  error() const &  { return error_; }
+	constexpr Error       && error()       && { return std::move(error_); }
 
-	error_or() : error_() {}
+	// Monadic operations, like those of error_or<T>, but f in and_then and
+	// transform gets no arguments.
 
-	bool ok() const { return ErrorIsOk()(error_); }
+	template<typename F>
+	constexpr detail_::invoke_result<F> and_then(F && f) const & {
+		if (ok()) return std::forward<F>(f)();
+		return detail_::invoke_result<F>(unchecked_error, error_);
+	}
+
+	template<typename F>
+	constexpr detail_::invoke_result<F> and_then(F && f) && {
+		if (ok()) return std::forward<F>(f)();
+		return detail_::invoke_result<F>(unchecked_error, std::move(error_));
+	}
 
-	explicit operator bool() const { return ok(); }
+	template<typename F>
+	constexpr error_or<detail_::invoke_result<F>, Error, ErrorIsOk> transform(F && f) const & {
+		using U = detail_::invoke_result<F>;
+		if (ok()) return detail_::transformed<U, Error, ErrorIsOk>::make(std::forward<F>(f));
+		return error_or<U, Error, ErrorIsOk>(unchecked_error, error_);
+	}
 
-	Error       &  error()       &  { return error_; }
-	Error const &  error() const &  { return error_; }
-	Error       && error()       && { return std::move(error_); }
+	template<typename F>
+	constexpr error_or<detail_::invoke_result<F>, Error, ErrorIsOk> transform(F && f) && {
+		using U = detail_::invoke_result<F>;
+		if (ok()) return detail_::transformed<U, Error, ErrorIsOk>::make(std::forward<F>(f));
+		return error_or<U, Error, ErrorIsOk>(unchecked_error, std::move(error_));
+	}
+
+	template<typename F>
+	constexpr error_or<void, detail_::invoke_result<F, Error const &>, ErrorIsOk> transform_error(F && f) const & {
+		using R = error_or<void, detail_::invoke_result<F, Error const &>, ErrorIsOk>;
+		if (ok()) return R();
+		return R(std::forward<F>(f)(error_));
+	}
+
+	template<typename F>
+	constexpr error_or<void, detail_::invoke_result<F, Error &&>, ErrorIsOk> transform_error(F && f) && {
+		using R = error_or<void, detail_::invoke_result<F, Error &&>, ErrorIsOk>;
+		if (ok()) return R();
+		return R(std::forward<F>(f)(std::move(error_)));
+	}
+
+	template<typename F>
+	constexpr detail_::invoke_result<F, Error const &> or_else(F && f) const & {
+		if (ok()) return detail_::invoke_result<F, Error const &>();
+		return std::forward<F>(f)(error_);
+	}
+
+	template<typename F>
+	constexpr detail_::invoke_result<F, Error &&> or_else(F && f) && {
+		if (ok()) return detail_::invoke_result<F, Error &&>();
+		return std::forward<F>(f)(std::move(error_));
+	}
 
 };
 
 // Comparison between error_or and error.
 
 template<typename T, typename Error>
-inline bool operator == (error_or<T, Error> const & a, Error const & b) {
+constexpr bool operator == (error_or<T, Error> const & a, Error const & b) {
 	return a.error() == b;
 }
 
 template<typename T, typename Error>
-inline bool operator != (error_or<T, Error> const & a, Error const & b) {
+constexpr bool operator != (error_or<T, Error> const & a, Error const & b) {
 	return a.error() != b;
 }
 
 template<typename T, typename Error>
-inline bool operator == (Error const & a, error_or<T, Error> const & b) {
+constexpr bool operator == (Error const & a, error_or<T, Error> const & b) {
 	return a == b.error();
 }
 
 template<typename T, typename Error>
-inline bool operator != (Error const & a, error_or<T, Error> const & b) {
+constexpr bool operator != (Error const & a, error_or<T, Error> const & b) {
 	return a != b.error();
 }
 
 // Comparison between error_or and value.
 
 template<typename T, typename Error>
-inline bool operator == (error_or<T, Error> const & a, T const & b) {
+constexpr bool operator == (error_or<T, Error> const & a, T const & b) {
 	if (!a.ok()) return false;
 	return a.value() == b;
 }
 
 template<typename T, typename Error>
-inline bool operator != (error_or<T, Error> const & a, T const & b) {
+constexpr bool operator != (error_or<T, Error> const & a, T const & b) {
 	if (!a.ok()) return true;
 	return a.value() != b;
 }
 
 template<typename T, typename Error>
-inline bool operator == (T const & a, error_or<T, Error> const & b) {
+constexpr bool operator == (T const & a, error_or<T, Error> const & b) {
 	if (!b.ok()) return false;
 	return a == b.value();
 }
 
 template<typename T, typename Error>
-inline bool operator != (T const & a, error_or<T, Error> const & b) {
+constexpr bool operator != (T const & a, error_or<T, Error> const & b) {
 	if (!b.ok()) return true;
 	return a != b.value();
 }
@@ -262,25 +632,25 @@ inline bool operator != (T const & a, error_or<T, Error> const & b) {
 // Comparison between error_ors.
 
 template<typename T1, typename E1, typename T2, typename E2>
-inline bool operator == (error_or<T1, E1> const & a, error_or<T2, E2> const & b) {
+constexpr bool operator == (error_or<T1, E1> const & a, error_or<T2, E2> const & b) {
 	if (a.ok() && b.ok()) return a.value() == b.value();
 	return a.error() == b.error();
 }
 
 template<typename T1, typename E1, typename T2, typename E2>
-inline bool operator != (error_or<T1, E1> const & a, error_or<T2, E2> const & b) {
+constexpr bool operator != (error_or<T1, E1> const & a, error_or<T2, E2> const & b) {
 	if (a.ok() && b.ok()) return a.value() != b.value();
 	return a.error() != b.error();
 }
 
 template<typename E1, typename E2>
-inline bool operator == (error_or<void, E1> const & a, error_or<void, E2> const & b) {
+constexpr bool operator == (error_or<void, E1> const & a, error_or<void, E2> const & b) {
 	if (a.ok() && b.ok()) return true;
 	return a.error() == b.error();
 }
 
 template<typename E1, typename E2>
-inline bool operator != (error_or<void, E1> const & a, error_or<void, E2> const & b) {
+constexpr bool operator != (error_or<void, E1> const & a, error_or<void, E2> const & b) {
 	if (a.ok() && b.ok()) return false;
 	return a.error() != b.error();
 }
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "error_or.hpp"
+#include "range.hpp"
+
+namespace mstd {
+
+// A sequence of error_or<T, Error>s, stored as separate arrays.
+//
+// The values are stored contiguously, without any errors in between, such
+// that they can be processed all at once using values(). The elements that
+// failed hold a value-initialized T, and are marked in a bitmap. Their errors
+// are kept in a separate list, sorted by index, which is expected to be
+// short.
+//
+// Example:
+//   mstd::error_or_batch<std::int64_t> decode(mstd::range<std::string const> column) {
+//     mstd::error_or_batch<std::int64_t> result;
+//     result.reserve(column.size());
+//     for (auto const & s : column) result.push_back(parse_int(s));
+//     return result;
+//   }
+//
+//   void use(mstd::error_or_batch<std::int64_t> const & batch) {
+//     for (auto const & e : batch.errors()) {
+//       std::cerr << "Element " << e.first << ": " << e.second.message() << "\n";
+//     }
+//     std::int64_t total = sum(batch.values());
+//     ...
+//   }
+template<
+	typename T,
+	typename Error = std::error_code,
+	typename ErrorIsOk = detail_::error_is_ok
+>
+class error_or_batch {
+
+public:
+	using value_type = T;
+	using error_type = Error;
+	using indexed_error = std::pair<std::size_t, Error>;
+
+	static_assert(!std::is_same<T, bool>::value, "error_or_batch<bool> would need std::vector<bool>::data()");
+
+private:
+	std::vector<T> values_;
+	std::vector<std::uint64_t> error_bits_;
+	std::vector<indexed_error> errors_;
+
+	static bool is_error(std::vector<std::uint64_t> const & bits, std::size_t i) {
+		return bits[i / 64] >> (i % 64) & 1;
+	}
+
+	typename std::vector<indexed_error>::iterator find_error(std::size_t i) {
+		return std::lower_bound(errors_.begin(), errors_.end(), i, [] (indexed_error const & e, std::size_t index) {
+			return e.first < index;
+		});
+	}
+
+	typename std::vector<indexed_error>::const_iterator find_error(std::size_t i) const {
+		return std::lower_bound(errors_.begin(), errors_.end(), i, [] (indexed_error const & e, std::size_t index) {
+			return e.first < index;
+		});
+	}
+
+	void grow_bits() {
+		if (values_.size() > error_bits_.size() * 64) error_bits_.push_back(0);
+	}
+
+public:
+	error_or_batch() {}
+
+	// n value-initialized values, without errors.
+	explicit error_or_batch(std::size_t n) : values_(n), error_bits_((n + 63) / 64) {}
+
+	std::size_t size() const { return values_.size(); }
+
+	bool empty() const { return values_.empty(); }
+
+	void reserve(std::size_t n) {
+		values_.reserve(n);
+		error_bits_.reserve((n + 63) / 64);
+	}
+
+	void clear() {
+		values_.clear();
+		error_bits_.clear();
+		errors_.clear();
+	}
+
+	void push_back(T value) {
+		values_.push_back(std::move(value));
+		grow_bits();
+	}
+
+	// e must not be a 'no error' value.
+	void push_back_error(Error e) {
+		values_.emplace_back();
+		grow_bits();
+		std::size_t i = values_.size() - 1;
+		error_bits_[i / 64] |= std::uint64_t(1) << (i % 64);
+		errors_.emplace_back(i, std::move(e));
+	}
+
+	void push_back(error_or<T, Error, ErrorIsOk> x) {
+		if (x) {
+			push_back(std::move(x).value());
+		} else {
+			push_back_error(std::move(x).error());
+		}
+	}
+
+	// Replaces element i by a value, removing its error, if any.
+	void set(std::size_t i, T value) {
+		values_[i] = std::move(value);
+		if (is_error(error_bits_, i)) {
+			error_bits_[i / 64] &= ~(std::uint64_t(1) << (i % 64));
+			errors_.erase(find_error(i));
+		}
+	}
+
+	// Replaces element i by an error. e must not be a 'no error' value.
+	void set_error(std::size_t i, Error e) {
+		values_[i] = T();
+		auto it = find_error(i);
+		if (is_error(error_bits_, i)) {
+			it->second = std::move(e);
+		} else {
+			error_bits_[i / 64] |= std::uint64_t(1) << (i % 64);
+			errors_.emplace(it, i, std::move(e));
+		}
+	}
+
+	bool ok(std::size_t i) const { return !is_error(error_bits_, i); }
+
+	bool all_ok() const { return errors_.empty(); }
+
+	std::size_t error_count() const { return errors_.size(); }
+
+	error_or<T &, Error, ErrorIsOk> operator [] (std::size_t i) {
+		if (MSTD_LIKELY(ok(i))) return values_[i];
+		return {unchecked_error, find_error(i)->second};
+	}
+
+	error_or<T const &, Error, ErrorIsOk> operator [] (std::size_t i) const {
+		if (MSTD_LIKELY(ok(i))) return values_[i];
+		return {unchecked_error, find_error(i)->second};
+	}
+
+	// All values, including the value-initialized ones of the failed elements.
+	range<T>       values()       { return {values_.data(), values_.size()}; }
+	range<T const> values() const { return {values_.data(), values_.size()}; }
+
+	// The errors with their indexes, sorted by index.
+	range<indexed_error const> errors() const { return {errors_.data(), errors_.size()}; }
+
+	// One bit per element, set for the failed elements. Element i is bit
+	// i % 64 of word i / 64. Bits past the last element are zero.
+	range<std::uint64_t const> error_bits() const { return {error_bits_.data(), error_bits_.size()}; }
+
+};
+
+}
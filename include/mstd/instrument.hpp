@@ -0,0 +1,316 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Instrumentation of refcount_ptr and error_or, for finding reference counts
+// that bounce between threads and for counting errors in production builds.
+//
+// Disabled by default, in which case none of the hooks are compiled in. To
+// enable it, define MSTD_INSTRUMENT to 1 before including any mstd header.
+// It must have the same value in every translation unit of a program.
+//
+// When enabled:
+//
+//  - One in MSTD_INSTRUMENT_SAMPLE_INTERVAL (a power of two, 64 by default)
+//    reference count increments and decrements, chosen randomly per thread,
+//    is recorded. On those, the use count is compared to the maximum seen,
+//    and the object is checked for having been used by another thread at its
+//    previous sampled operation.
+//
+//  - The same fraction of objects destroyed by their last reference, and of
+//    error_or's constructed from an error, is counted.
+//
+// Everything is counted per type (the refcounted type, i.e. the object that
+// holds the count) and per error category, in relaxed atomic counters that
+// only ever grow. Since those are shared between threads themselves, only
+// sampled operations write to them. (Destroying an object also reads the
+// slot used for detecting contention, to write it only if it holds that
+// object.) All counts are estimates: the sampled ones times the interval. Read them with for_each_refcount_counters()
+// and for_each_error_counters(), e.g. periodically from an exporter thread.
+// Both are available (and do nothing) when instrumentation is disabled.
+//
+// Type names come from typeid, so they need RTTI, and are mangled on most
+// compilers. Instrumented error_or(Error) constructors can no longer be used
+// in constant expressions.
+#ifndef MSTD_INSTRUMENT
+#define MSTD_INSTRUMENT 0
+#endif
+
+#ifndef MSTD_INSTRUMENT_SAMPLE_INTERVAL
+#define MSTD_INSTRUMENT_SAMPLE_INTERVAL 64
+#endif
+
+#if MSTD_INSTRUMENT
+#include <atomic>
+#include <system_error>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+#endif
+
+namespace mstd {
+
+// A snapshot of the counters of one refcounted type.
+//
+// increments and decrements are estimates of the number of references added
+// and dropped, and frees of the objects destroyed: those of sampled
+// operations, times the sample interval.
+// (So share(n) and reset_all() count as n.) contended is an estimate of the
+// number of contended operations, where an operation is contended when the
+// previous sampled operation on the same object was on a different thread,
+// which means the cache line of its count moved between threads.
+// last_contended is the last object on which that happened, to find out which
+// one it is. max_use_count is the highest use count seen on a sampled
+// increment. References that atomic_refcount_ptr temporarily adds while
+// replacing its pointer are internal, and not counted.
+struct refcount_counters {
+	char const * type;
+	std::uint64_t increments;
+	std::uint64_t decrements;
+	std::uint64_t frees;
+	std::uint64_t contended;
+	std::uint64_t max_use_count;
+	void const * last_contended;
+};
+
+// A snapshot of the (estimated, like refcount_counters) number of errors
+// stored in an error_or with an error of a category. The name is that of the error_category, or, for error types
+// without a category() (e.g. int), the name of the type.
+struct error_counters {
+	char const * category;
+	std::uint64_t errors;
+};
+
+#if MSTD_INSTRUMENT
+
+namespace instrument_detail {
+
+static_assert(
+	MSTD_INSTRUMENT_SAMPLE_INTERVAL > 0 &&
+	(MSTD_INSTRUMENT_SAMPLE_INTERVAL & (MSTD_INSTRUMENT_SAMPLE_INTERVAL - 1)) == 0,
+	"MSTD_INSTRUMENT_SAMPLE_INTERVAL must be a power of two"
+);
+
+constexpr std::uint64_t interval = MSTD_INSTRUMENT_SAMPLE_INTERVAL;
+
+// A small number identifying the calling thread. Never zero.
+inline std::uint32_t thread_index() noexcept {
+	static std::atomic<std::uint32_t> next{1};
+	static thread_local std::uint32_t index = next.fetch_add(1, std::memory_order_relaxed);
+	return index;
+}
+
+// Randomly decides whether to record this operation, such that regular
+// access patterns (like an increment followed by a decrement) don't skew what
+// is sampled.
+inline bool sample() noexcept {
+	static thread_local std::uint32_t state = thread_index() * 2654435761u;
+	std::uint32_t x = state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	state = x;
+	return (x & (interval - 1)) == 0;
+}
+
+inline void update_max(std::atomic<std::uint64_t> & max, std::uint64_t value) noexcept {
+	std::uint64_t m = max.load(std::memory_order_relaxed);
+	while (value > m && !max.compare_exchange_weak(m, value, std::memory_order_relaxed)) {}
+}
+
+// The counters of one refcounted type. Registered in a global list on
+// construction, and never destroyed before the end of the program.
+struct alignas(64) refcount_stats {
+	// The object and thread of the last sampled operation, for objects
+	// hashing to a slot.
+	struct slot {
+		std::atomic<void const *> object{nullptr};
+		std::atomic<std::uint32_t> thread{0};
+	};
+
+	static constexpr std::size_t n_slots = 16;
+
+	char const * type;
+	refcount_stats * next;
+	std::atomic<std::uint64_t> increments{0};
+	std::atomic<std::uint64_t> decrements{0};
+	std::atomic<std::uint64_t> frees{0};
+	std::atomic<std::uint64_t> contended{0};
+	std::atomic<std::uint64_t> max_use_count{0};
+	std::atomic<void const *> last_contended{nullptr};
+	slot slots[n_slots];
+
+	static std::atomic<refcount_stats *> & list() noexcept {
+		static std::atomic<refcount_stats *> head{nullptr};
+		return head;
+	}
+
+	explicit refcount_stats(char const * t) noexcept : type(t) {
+		auto & head = list();
+		next = head.load(std::memory_order_relaxed);
+		while (!head.compare_exchange_weak(next, this, std::memory_order_release, std::memory_order_relaxed)) {}
+	}
+
+	slot & slot_of(void const * object) noexcept {
+		return slots[(reinterpret_cast<std::uintptr_t>(object) >> 4) % n_slots];
+	}
+
+	void check_contention(void const * object) noexcept {
+		auto & s = slot_of(object);
+		std::uint32_t me = thread_index();
+		if (s.object.load(std::memory_order_relaxed) != object) {
+			s.object.store(object, std::memory_order_relaxed);
+		} else if (s.thread.load(std::memory_order_relaxed) == me) {
+			return;
+		} else {
+			contended.fetch_add(interval, std::memory_order_relaxed);
+			last_contended.store(object, std::memory_order_relaxed);
+		}
+		s.thread.store(me, std::memory_order_relaxed);
+	}
+};
+
+template<typename T>
+refcount_stats & stats_of() noexcept {
+	static refcount_stats stats(typeid(T).name());
+	return stats;
+}
+
+// Called after every increment by n, with the new use count, or zero if it
+// is unknown.
+template<typename T>
+void on_increment(void const * object, std::size_t n, std::size_t use_count) noexcept {
+	if (!sample()) return;
+	auto & s = stats_of<T>();
+	s.increments.fetch_add(n * interval, std::memory_order_relaxed);
+	update_max(s.max_use_count, use_count);
+	s.check_contention(object);
+}
+
+// Called after every decrement by n, including the last one.
+template<typename T>
+void on_decrement(void const * object, std::size_t n) noexcept {
+	if (!sample()) return;
+	auto & s = stats_of<T>();
+	s.decrements.fetch_add(n * interval, std::memory_order_relaxed);
+	s.check_contention(object);
+}
+
+// Called right before an object is destroyed by its last reference.
+// Forgets about the object, such that a new one at the same address that is
+// used by another thread doesn't count as contended.
+template<typename T>
+void on_free(void const * object) noexcept {
+	auto & s = stats_of<T>();
+	if (sample()) s.frees.fetch_add(interval, std::memory_order_relaxed);
+	auto & slot = s.slot_of(object);
+	void const * expected = object;
+	if (slot.object.load(std::memory_order_relaxed) == object) {
+		slot.object.compare_exchange_strong(expected, nullptr, std::memory_order_relaxed);
+	}
+}
+
+// Error counts, in a fixed size table keyed on the error_category (or the
+// type of the error, for errors without a category). Errors that don't fit
+// in the table are counted as overflow.
+struct error_stats {
+	struct entry {
+		std::atomic<void const *> key{nullptr};
+		// Set right after key, so can be briefly missing.
+		std::atomic<char const *> name{nullptr};
+		std::atomic<std::uint64_t> errors{0};
+	};
+
+	static constexpr std::size_t n_entries = 64;
+
+	entry entries[n_entries];
+	std::atomic<std::uint64_t> overflow{0};
+
+	static error_stats & get() noexcept {
+		static error_stats stats;
+		return stats;
+	}
+
+	void count(void const * key, char const * name) noexcept {
+		std::size_t i = (reinterpret_cast<std::uintptr_t>(key) >> 4) % n_entries;
+		for (std::size_t n = 0; n < n_entries; ++n, i = (i + 1) % n_entries) {
+			auto & e = entries[i];
+			void const * k = e.key.load(std::memory_order_acquire);
+			if (k == nullptr) {
+				if (e.key.compare_exchange_strong(k, key, std::memory_order_acq_rel)) {
+					e.name.store(name, std::memory_order_release);
+					k = key;
+				}
+			}
+			if (k == key) {
+				e.errors.fetch_add(interval, std::memory_order_relaxed);
+				return;
+			}
+		}
+		overflow.fetch_add(interval, std::memory_order_relaxed);
+	}
+};
+
+template<typename E>
+auto count_error(E const & e, int) noexcept -> decltype(void(std::declval<std::error_category const &>() == e.category())) {
+	std::error_category const & category = e.category();
+	error_stats::get().count(&category, category.name());
+}
+
+template<typename E>
+void count_error(E const &, long) noexcept {
+	error_stats::get().count(&typeid(E), typeid(E).name());
+}
+
+// Called when an error_or is constructed from an error.
+template<typename E>
+void on_error(E const & e) noexcept {
+	if (sample()) count_error(e, 0);
+}
+
+}
+
+// Calls f with the refcount_counters of every refcounted type that was
+// sampled at least once.
+template<typename F>
+void for_each_refcount_counters(F && f) {
+	auto s = instrument_detail::refcount_stats::list().load(std::memory_order_acquire);
+	for (; s; s = s->next) {
+		f(refcount_counters{
+			s->type,
+			s->increments.load(std::memory_order_relaxed),
+			s->decrements.load(std::memory_order_relaxed),
+			s->frees.load(std::memory_order_relaxed),
+			s->contended.load(std::memory_order_relaxed),
+			s->max_use_count.load(std::memory_order_relaxed),
+			s->last_contended.load(std::memory_order_relaxed),
+		});
+	}
+}
+
+// Calls f with the error_counters of every category that had an error.
+// Errors that didn't fit in the table are reported with a category of
+// "(overflow)".
+template<typename F>
+void for_each_error_counters(F && f) {
+	auto & stats = instrument_detail::error_stats::get();
+	for (auto & e : stats.entries) {
+		char const * name = e.name.load(std::memory_order_acquire);
+		if (name) f(error_counters{name, e.errors.load(std::memory_order_relaxed)});
+	}
+	if (auto n = stats.overflow.load(std::memory_order_relaxed)) f(error_counters{"(overflow)", n});
+}
+
+#else
+
+// Without instrumentation, there is nothing to report.
+template<typename F>
+void for_each_refcount_counters(F &&) {}
+
+template<typename F>
+void for_each_error_counters(F &&) {}
+
+#endif
+
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+
+#if defined(_WIN32)
+#include <winsock2.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <sys/uio.h>
+#endif
+
+#include "bytes.hpp"
+#include "range.hpp"
+
+// Conversion of ranges of bytes to the scatter-gather buffers of the
+// platform. Separate from bytes.hpp, so that only users of these include the
+// system headers they need.
+
+namespace mstd {
+
+#if defined(_WIN32)
+
+// Fills out with WSABUFs for the pieces, for WSASend() and WSARecv(), and
+// returns the filled part. Pieces must not be larger than 4 GiB.
+//
+// Example:
+//   mstd::range<mstd::byte const> pieces[] = {header, body};
+//   WSABUF bufs[2];
+//   WSASend(socket, bufs, DWORD(mstd::to_wsabufs(pieces, bufs).size()), &sent, 0, nullptr, nullptr);
+inline range<WSABUF> to_wsabufs(range<range<byte const> const> pieces, range<WSABUF> out) {
+	assert(out.size() >= pieces.size());
+	for (std::size_t i = 0; i < pieces.size(); ++i) {
+		assert(pieces[i].size() <= ULONG(-1));
+		out[i].buf = const_cast<CHAR *>(reinterpret_cast<CHAR const *>(pieces[i].data()));
+		out[i].len = ULONG(pieces[i].size());
+	}
+	return out.subrange(0, pieces.size());
+}
+
+inline range<WSABUF> to_wsabufs(range<range<byte> const> pieces, range<WSABUF> out) {
+	assert(out.size() >= pieces.size());
+	for (std::size_t i = 0; i < pieces.size(); ++i) {
+		assert(pieces[i].size() <= ULONG(-1));
+		out[i].buf = reinterpret_cast<CHAR *>(pieces[i].data());
+		out[i].len = ULONG(pieces[i].size());
+	}
+	return out.subrange(0, pieces.size());
+}
+
+#elif defined(__unix__) || defined(__APPLE__)
+
+// Fills out with iovecs for the pieces, for writev() and readv(), and
+// returns the filled part. Pieces can then be written with a single system
+// call, without first copying them into one buffer.
+//
+// Example:
+//   mstd::range<mstd::byte const> pieces[] = {header, body};
+//   iovec iov[2];
+//   mstd::range<iovec> v = mstd::to_iovecs(pieces, iov);
+//   writev(fd, v.data(), int(v.size()));
+inline range<iovec> to_iovecs(range<range<byte const> const> pieces, range<iovec> out) {
+	assert(out.size() >= pieces.size());
+	for (std::size_t i = 0; i < pieces.size(); ++i) {
+		out[i].iov_base = const_cast<byte *>(pieces[i].data());
+		out[i].iov_len = pieces[i].size();
+	}
+	return out.subrange(0, pieces.size());
+}
+
+inline range<iovec> to_iovecs(range<range<byte> const> pieces, range<iovec> out) {
+	assert(out.size() >= pieces.size());
+	for (std::size_t i = 0; i < pieces.size(); ++i) {
+		out[i].iov_base = pieces[i].data();
+		out[i].iov_len = pieces[i].size();
+	}
+	return out.subrange(0, pieces.size());
+}
+
+#endif
+
+}
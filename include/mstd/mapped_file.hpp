@@ -0,0 +1,230 @@
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <system_error>
+#include <utility>
+
+#if defined(_WIN32)
+#include <winsock2.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "bytes.hpp"
+#include "error_or.hpp"
+#include "range.hpp"
+#include "unique.hpp"
+
+namespace mstd {
+
+// Hints about how a mapped_file will be accessed. Hints the platform doesn't
+// support are ignored. On Windows, that is all but willneed, which uses
+// PrefetchVirtualMemory, and needs _WIN32_WINNT to be at least Windows 8.
+enum class map_advice {
+	normal,
+	sequential, // Read ahead aggressively, and drop pages soon after they are read.
+	random,     // Don't read ahead.
+	willneed,   // Start reading the pages in the background now.
+	hugepages,  // Use transparent huge pages, where supported (Linux).
+};
+
+struct map_options {
+	// Read the whole file into memory while mapping it, rather than when the
+	// pages are first accessed. This makes open() slower, but avoids page
+	// faults while using the contents.
+	bool prefault = false;
+
+	map_advice advice = map_advice::normal;
+};
+
+namespace mapped_file_detail {
+
+struct mapping {
+	void * data = nullptr;
+	std::size_t size = 0;
+
+	explicit operator bool() const { return data != nullptr; }
+
+	friend bool operator == (mapping a, mapping b) { return a.data == b.data; }
+	friend bool operator != (mapping a, mapping b) { return a.data != b.data; }
+};
+
+struct unmap {
+	void operator () (mapping m) const {
+#if defined(_WIN32)
+		UnmapViewOfFile(m.data);
+#else
+		munmap(m.data, m.size);
+#endif
+	}
+};
+
+inline std::error_code last_error() {
+#if defined(_WIN32)
+	return std::error_code(int(GetLastError()), std::system_category());
+#else
+	return std::error_code(errno, std::system_category());
+#endif
+}
+
+inline std::size_t page_size() {
+#if defined(_WIN32)
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwPageSize;
+#else
+	static std::size_t const size = std::size_t(sysconf(_SC_PAGESIZE));
+	return size;
+#endif
+}
+
+// Reads one byte of every page.
+inline void touch_pages(range<byte const> r) {
+	unsigned char sum = 0;
+	for (std::size_t i = 0; i < r.size(); i += page_size()) {
+		sum += static_cast<unsigned char>(static_cast<byte const volatile &>(r[i]));
+	}
+	(void)sum;
+}
+
+}
+
+// The contents of a file, mapped into memory (read-only).
+//
+// Pages are only read from the file when they are accessed, unless prefault
+// is set in the options. The mapping stays valid after the file itself is
+// closed, and shares the page cache with other processes reading the file.
+//
+// Example:
+//   mstd::error_or<mstd::mapped_file> file = mstd::mapped_file::open("index.bin", {true, mstd::map_advice::random});
+//   if (!file) return file.error();
+//   mstd::range<Entry const> entries = mstd::range_cast<Entry const>(file->bytes());
+class mapped_file {
+
+	unique<mapped_file_detail::mapping, mapped_file_detail::unmap> mapping_;
+
+	explicit mapped_file(mapped_file_detail::mapping m) : mapping_(m) {}
+
+public:
+	// An empty mapping.
+	mapped_file() {}
+
+	// Maps the file at path. An empty file gives an empty mapping.
+	static error_or<mapped_file> open(char const * path, map_options options = map_options()) {
+		mapped_file_detail::mapping m;
+#if defined(_WIN32)
+		HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) return mapped_file_detail::last_error();
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size)) {
+			auto e = mapped_file_detail::last_error();
+			CloseHandle(file);
+			return e;
+		}
+		if (size.QuadPart == 0) {
+			CloseHandle(file);
+			return mapped_file();
+		}
+		HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!mapping) {
+			auto e = mapped_file_detail::last_error();
+			CloseHandle(file);
+			return e;
+		}
+		m.data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		auto e = mapped_file_detail::last_error();
+		CloseHandle(mapping);
+		CloseHandle(file);
+		if (!m.data) return e;
+		m.size = std::size_t(size.QuadPart);
+#else
+		int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+		if (fd < 0) return mapped_file_detail::last_error();
+		struct stat s;
+		if (fstat(fd, &s) != 0) {
+			auto e = mapped_file_detail::last_error();
+			::close(fd);
+			return e;
+		}
+		if (s.st_size == 0) {
+			::close(fd);
+			return mapped_file();
+		}
+		int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+		if (options.prefault) flags |= MAP_POPULATE;
+#endif
+		void * data = mmap(nullptr, std::size_t(s.st_size), PROT_READ, flags, fd, 0);
+		auto e = mapped_file_detail::last_error();
+		::close(fd);
+		if (data == MAP_FAILED) return e;
+		m.data = data;
+		m.size = std::size_t(s.st_size);
+#endif
+		mapped_file result(m);
+		if (options.advice != map_advice::normal) result.advise(options.advice);
+#if defined(_WIN32) || !defined(MAP_POPULATE)
+		if (options.prefault) mapped_file_detail::touch_pages(result.bytes());
+#endif
+		return error_or<mapped_file>(std::move(result));
+	}
+
+	range<byte const> bytes() const {
+		return {static_cast<byte const *>(mapping_->data), mapping_->size};
+	}
+
+	std::size_t size() const { return mapping_->size; }
+
+	bool empty() const { return mapping_->size == 0; }
+
+	// Gives a hint about how the bytes [offset, offset + length) will be
+	// accessed. The range is clamped to the mapping, and extended to whole
+	// pages. Does nothing for hints the platform doesn't support (see
+	// map_advice).
+	error_or<void> advise(map_advice advice, std::size_t offset = 0, std::size_t length = std::size_t(-1)) const {
+		if (offset >= size()) return {};
+		if (length > size() - offset) length = size() - offset;
+		std::size_t start = offset - offset % mapped_file_detail::page_size();
+#if defined(_WIN32)
+#if defined(_WIN32_WINNT) && _WIN32_WINNT >= 0x0602
+		if (advice == map_advice::willneed) {
+			WIN32_MEMORY_RANGE_ENTRY entry;
+			entry.VirtualAddress = static_cast<char *>(mapping_->data) + start;
+			entry.NumberOfBytes = offset + length - start;
+			if (!PrefetchVirtualMemory(GetCurrentProcess(), 1, &entry, 0)) return mapped_file_detail::last_error();
+		}
+#else
+		(void)advice;
+		(void)start;
+#endif
+#else
+		int a;
+		switch (advice) {
+			case map_advice::normal: a = MADV_NORMAL; break;
+			case map_advice::sequential: a = MADV_SEQUENTIAL; break;
+			case map_advice::random: a = MADV_RANDOM; break;
+			case map_advice::willneed: a = MADV_WILLNEED; break;
+#ifdef MADV_HUGEPAGE
+			case map_advice::hugepages: a = MADV_HUGEPAGE; break;
+#endif
+			default: return {};
+		}
+		if (madvise(static_cast<char *>(mapping_->data) + start, offset + length - start, a) != 0) {
+			return mapped_file_detail::last_error();
+		}
+#endif
+		return {};
+	}
+
+	// Unmaps the file, leaving this mapping empty.
+	void close() {
+		unique<mapped_file_detail::mapping, mapped_file_detail::unmap> m(mapping_.release());
+	}
+};
+
+}
@@ -0,0 +1,309 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include "refcount.hpp"
+#include "unique.hpp"
+
+namespace mstd {
+
+namespace pool_detail {
+
+struct free_block {
+	free_block * next;
+};
+
+// Kept out of line, to keep the exception out of allocate().
+#if defined(__GNUC__) || defined(__clang__)
+__attribute__((noinline, cold))
+#endif
+[[noreturn]] inline void bad_alloc() {
+#if defined(__cpp_exceptions) || defined(__EXCEPTIONS) || defined(_CPPUNWIND)
+	throw std::bad_alloc();
+#else
+	std::abort();
+#endif
+}
+
+// Fixed size blocks, allocated by one thread (the owner), and returned by any
+// thread.
+//
+// Blocks returned by the owner go on a plain free list. Blocks returned by
+// other threads are pushed on an atomic stack, which the owner takes over as
+// a whole when its own list runs out. (Since nothing but the owner ever pops
+// from that stack, there is no ABA problem.)
+//
+// The block_pool is heap allocated, and outlives the pool object that owns
+// it if there are still blocks in use: orphan() makes the last returned block
+// delete it.
+class block_pool {
+
+	struct slab {
+		slab * next;
+		void * allocation;
+	};
+
+	std::size_t const block_size_;
+	std::size_t const alignment_;
+
+	std::atomic<std::thread::id> owner_;
+
+	// Owner only:
+	free_block * local_ = nullptr;
+	char * fresh_ = nullptr; // Blocks not handed out before.
+	std::size_t fresh_left_ = 0;
+	std::size_t next_slab_blocks_ = 16;
+	std::size_t carved_ = 0;
+	slab * slabs_ = nullptr;
+
+	// Keeps the fields above and below on different cache lines. (Not
+	// alignas, since new doesn't support over-aligned types before C++17.)
+	char padding_[64];
+
+	std::atomic<free_block *> remote_{nullptr};
+
+	// After orphan(): the number of blocks still in use. remote_ is then
+	// orphaned_marker().
+	std::atomic<std::size_t> remaining_{0};
+
+	free_block * orphaned_marker() noexcept { return reinterpret_cast<free_block *>(&remaining_); }
+
+	static std::size_t round_up(std::size_t n, std::size_t a) { return (n + a - 1) / a * a; }
+
+	void add_slab() {
+		std::size_t n = next_slab_blocks_;
+		if (next_slab_blocks_ < 1024) next_slab_blocks_ *= 2;
+		std::size_t header = round_up(sizeof(slab), alignment_);
+		void * allocation = std::malloc(header + n * block_size_ + alignment_ - 1);
+		if (!allocation) bad_alloc();
+		char * start = reinterpret_cast<char *>(round_up(reinterpret_cast<std::uintptr_t>(allocation), alignment_));
+		slabs_ = ::new (static_cast<void *>(start)) slab{slabs_, allocation};
+		fresh_ = start + header;
+		fresh_left_ = n;
+	}
+
+	~block_pool() {
+		for (slab * s = slabs_; s;) {
+			slab * next = s->next;
+			std::free(s->allocation);
+			s = next;
+		}
+	}
+
+	void remote_deallocate(free_block * b) noexcept {
+		free_block * head = remote_.load(std::memory_order_acquire);
+		do {
+			if (head == orphaned_marker()) {
+				if (remaining_.fetch_sub(1, std::memory_order_acq_rel) == 1) delete this;
+				return;
+			}
+			b->next = head;
+		} while (!remote_.compare_exchange_weak(head, b, std::memory_order_acq_rel, std::memory_order_acquire));
+	}
+
+public:
+	block_pool(std::size_t block_size, std::size_t alignment) noexcept
+		: block_size_(round_up(block_size < sizeof(free_block) ? sizeof(free_block) : block_size, alignment < alignof(free_block) ? alignof(free_block) : alignment)),
+		  alignment_(alignment < alignof(free_block) ? alignof(free_block) : alignment),
+		  owner_(std::this_thread::get_id()) {}
+
+	block_pool(block_pool const &) = delete;
+	block_pool & operator = (block_pool const &) = delete;
+
+	std::size_t block_size() const noexcept { return block_size_; }
+	std::size_t alignment() const noexcept { return alignment_; }
+
+	// Only from the owner thread.
+	void * allocate() {
+		assert(owner_.load(std::memory_order_relaxed) == std::this_thread::get_id());
+		if (!local_ && remote_.load(std::memory_order_relaxed)) local_ = remote_.exchange(nullptr, std::memory_order_acquire);
+		if (local_) {
+			free_block * b = local_;
+			local_ = b->next;
+			return b;
+		}
+		if (!fresh_left_) add_slab();
+		void * b = fresh_;
+		fresh_ += block_size_;
+		--fresh_left_;
+		++carved_;
+		return b;
+	}
+
+	// From any thread.
+	void deallocate(void * p) noexcept {
+		free_block * b = static_cast<free_block *>(p);
+		if (owner_.load(std::memory_order_relaxed) == std::this_thread::get_id()) {
+			b->next = local_;
+			local_ = b;
+		} else {
+			remote_deallocate(b);
+		}
+	}
+
+	// Called by the owner instead of deleting the block_pool. It is deleted
+	// right away if no blocks are in use, or otherwise when the last one is
+	// returned.
+	//
+	// Only from the owner thread: it walks the local free list, to which the
+	// owner pushes without synchronization.
+	void orphan() noexcept {
+		assert(owner_.load(std::memory_order_relaxed) == std::this_thread::get_id() && "pool destroyed by a thread other than the one that created it");
+		owner_.store(std::thread::id(), std::memory_order_relaxed);
+		remaining_.store(carved_, std::memory_order_relaxed);
+		std::size_t free = 0;
+		for (free_block * b = local_; b; b = b->next) ++free;
+		for (free_block * b = remote_.exchange(orphaned_marker(), std::memory_order_acq_rel); b; b = b->next) ++free;
+		if (free == carved_ || remaining_.fetch_sub(free, std::memory_order_acq_rel) == free) delete this;
+	}
+};
+
+}
+
+// An std::allocator-compatible allocator allocating blocks from an
+// object_pool or refcount_pool. It can only allocate what fits in one block.
+template<typename T>
+struct pool_allocator {
+	using value_type = T;
+
+	explicit pool_allocator(pool_detail::block_pool * pool) noexcept : pool_(pool) {}
+
+	template<typename U>
+	pool_allocator(pool_allocator<U> const & other) noexcept : pool_(other.pool()) {}
+
+	T * allocate(std::size_t n) {
+		assert(n * sizeof(T) <= pool_->block_size() && alignof(T) <= pool_->alignment());
+		(void)n;
+		return static_cast<T *>(pool_->allocate());
+	}
+
+	void deallocate(T * p, std::size_t) noexcept { pool_->deallocate(p); }
+
+	pool_detail::block_pool * pool() const noexcept { return pool_; }
+
+	template<typename U>
+	friend bool operator == (pool_allocator const & a, pool_allocator<U> const & b) noexcept { return a.pool_ == b.pool(); }
+
+	template<typename U>
+	friend bool operator != (pool_allocator const & a, pool_allocator<U> const & b) noexcept { return a.pool_ != b.pool(); }
+
+private:
+	pool_detail::block_pool * pool_;
+};
+
+// Closer for unique<T *, pool_closer<T>>, which destroys the object and gives
+// its memory back to the object_pool it came from.
+template<typename T>
+struct pool_closer {
+	pool_detail::block_pool * pool = nullptr;
+
+	void operator () (T * object) const noexcept {
+		object->~T();
+		pool->deallocate(object);
+	}
+};
+
+template<typename T>
+using pooled_unique = unique<T *, pool_closer<T>>;
+
+// A pool of memory for objects of type T, to reuse memory of destroyed objects
+// without going through the general purpose allocator.
+//
+// Objects can only be created by the thread that created the pool, but they
+// can be destroyed by any thread. The pool itself must also be destroyed by
+// the thread that created it. Objects destroyed by the creating thread
+// are reused right away, without any synchronization. Objects destroyed by
+// other threads are handed back using a lock-free stack. For multiple threads
+// creating objects, use one pool per thread, e.g. a thread_local one.
+//
+// The pool may be destroyed while its objects are still in use. Its memory is
+// freed when they are all destroyed.
+//
+// Example:
+//   thread_local mstd::object_pool<Message> message_pool;
+//
+//   mstd::pooled_unique<Message> m = message_pool.make_unique(...);
+template<typename T>
+class object_pool {
+
+	pool_detail::block_pool * pool_;
+
+public:
+	object_pool() : pool_(new pool_detail::block_pool(sizeof(T), alignof(T))) {}
+
+	object_pool(object_pool const &) = delete;
+	object_pool & operator = (object_pool const &) = delete;
+
+	~object_pool() { pool_->orphan(); }
+
+	template<typename... Args>
+	T * create(Args &&... args) {
+		void * p = pool_->allocate();
+		auto guard = refcount_detail::on_unwind([this, p] { pool_->deallocate(p); });
+		T * object = ::new (p) T(std::forward<Args>(args)...);
+		guard.dismiss();
+		return object;
+	}
+
+	// Destroys an object made by create(). Can be used from any thread.
+	void destroy(T * object) noexcept { closer()(object); }
+
+	template<typename... Args>
+	pooled_unique<T> make_unique(Args &&... args) {
+		return pooled_unique<T>(create(std::forward<Args>(args)...), closer());
+	}
+
+	pool_closer<T> closer() const noexcept { return pool_closer<T>{pool_}; }
+
+	pool_allocator<T> allocator() const noexcept { return pool_allocator<T>(pool_); }
+};
+
+// Like object_pool, but for objects that are reference counted with
+// refcount_ptr, made by allocate_refcount. When the last reference (including
+// weak references) is gone, the memory goes back to the pool, as with
+// object_pool::destroy. Also like object_pool, it must be created, used and
+// destroyed by one thread.
+//
+// Example:
+//   thread_local mstd::refcount_pool<Session> session_pool;
+//
+//   mstd::refcount_ptr<Session> s = session_pool.make(...);
+template<typename T>
+class refcount_pool {
+
+	using allocation = refcount_detail::allocation<typename refcount_ptr<T>::refcounted_type, pool_allocator<char>>;
+
+	pool_detail::block_pool * pool_;
+
+public:
+	// The size of the memory used for every object, including its reference
+	// count and allocation header.
+	static constexpr std::size_t block_size = allocation::total_units * sizeof(typename allocation::unit);
+
+	refcount_pool() : pool_(new pool_detail::block_pool(block_size, alignof(typename allocation::unit))) {}
+
+	refcount_pool(refcount_pool const &) = delete;
+	refcount_pool & operator = (refcount_pool const &) = delete;
+
+	~refcount_pool() { pool_->orphan(); }
+
+	template<typename... Args>
+	refcount_ptr<T> make(Args &&... args) {
+		return allocate_refcount<T>(pool_allocator<char>(pool_), std::forward<Args>(args)...);
+	}
+};
+
+#if __cplusplus < 201703L
+template<typename T>
+constexpr std::size_t refcount_pool<T>::block_size;
+#endif
+
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "partition.hpp"
+#include "range.hpp"
+
+namespace mstd {
+
+// A fixed set of worker threads for fork-join parallelism.
+//
+// run(n, f) calls f(0) to f(n - 1), spread over the workers and the calling
+// thread, and returns when all calls are done. Nothing is allocated per call.
+// run may be used from multiple threads at once, and from inside f.
+//
+// f must not throw: if it does, std::terminate is called. This holds as well
+// when all calls are made on the calling thread, e.g. if the pool has no
+// workers or n is 1.
+class thread_pool {
+
+	struct job {
+		void (*call)(void *, std::size_t);
+		void * f;
+		std::size_t n;
+		std::atomic<std::size_t> next{0};
+
+		// The number of workers that picked up this job but didn't finish it yet.
+		std::size_t running = 0;
+		std::condition_variable done;
+
+		void work() noexcept {
+			for (std::size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < n;) call(f, i);
+		}
+	};
+
+	std::mutex mutex_;
+	std::condition_variable wake_;
+	std::deque<job *> queue_;
+	bool stop_ = false;
+	std::vector<std::thread> threads_;
+
+	// noexcept, so a throwing f terminates here just like in job::work().
+	template<typename F>
+	static void run_here(std::size_t n, F & f) noexcept {
+		for (std::size_t i = 0; i < n; ++i) f(i);
+	}
+
+	void worker() {
+		std::unique_lock<std::mutex> lock(mutex_);
+		while (true) {
+			wake_.wait(lock, [&] { return stop_ || !queue_.empty(); });
+			if (queue_.empty()) return;
+			job * j = queue_.front();
+			queue_.pop_front();
+			++j->running;
+			lock.unlock();
+			j->work();
+			lock.lock();
+			if (--j->running == 0) j->done.notify_one();
+		}
+	}
+
+public:
+	// A pool with one worker less than the number of hardware threads, since
+	// the thread calling run() works as well.
+	thread_pool() : thread_pool(std::max(std::thread::hardware_concurrency(), 1u) - 1) {}
+
+	explicit thread_pool(std::size_t workers) {
+		threads_.reserve(workers);
+		for (std::size_t i = 0; i < workers; ++i) threads_.emplace_back([this] { worker(); });
+	}
+
+	thread_pool(thread_pool const &) = delete;
+	thread_pool & operator = (thread_pool const &) = delete;
+
+	~thread_pool() {
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			stop_ = true;
+		}
+		wake_.notify_all();
+		for (auto & t : threads_) t.join();
+	}
+
+	// The number of worker threads, not counting the thread calling run().
+	std::size_t size() const { return threads_.size(); }
+
+	template<typename F>
+	void run(std::size_t n, F && f) {
+		if (n == 0) return;
+		std::size_t helpers = std::min(n - 1, threads_.size());
+		if (helpers == 0) return run_here(n, f);
+
+		job j;
+		j.call = [] (void * p, std::size_t i) { (*static_cast<typename std::remove_reference<F>::type *>(p))(i); };
+		j.f = const_cast<void *>(static_cast<void const *>(&f));
+		j.n = n;
+
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			queue_.insert(queue_.end(), helpers, &j);
+		}
+		if (helpers == 1) wake_.notify_one(); else wake_.notify_all();
+
+		j.work();
+
+		// Withdraw the copies that no worker picked up, and wait for the
+		// workers that did.
+		std::unique_lock<std::mutex> lock(mutex_);
+		queue_.erase(std::remove(queue_.begin(), queue_.end(), &j), queue_.end());
+		j.done.wait(lock, [&] { return j.running == 0; });
+	}
+};
+
+// The thread_pool used by parallel_for_each() if none is given. It is created
+// when first used.
+inline thread_pool & default_thread_pool() {
+	static thread_pool pool;
+	return pool;
+}
+
+// Calls f(x) for every element x of r, using all threads of pool and the
+// calling thread. Every thread handles a part of r given by
+// partition_for_threads(), so threads don't write to the same cache lines.
+//
+// Example:
+//   mstd::parallel_for_each(mstd::range<float>(samples), [] (float & x) { x *= 0.5f; });
+template<typename T, typename F>
+void parallel_for_each(thread_pool & pool, range<T> r, F && f) {
+	auto parts = partition_for_threads(r, std::min(pool.size() + 1, std::max(r.size(), std::size_t(1))));
+	pool.run(parts.size(), [&] (std::size_t i) {
+		for (T & x : parts[i]) f(x);
+	});
+}
+
+template<typename T, typename F>
+void parallel_for_each(range<T> r, F && f) {
+	parallel_for_each(default_thread_pool(), r, f);
+}
+
+}
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+
+#include "range.hpp"
+
+namespace mstd {
+
+// The size of a cache line that partition_for_threads() avoids sharing
+// between parts.
+constexpr std::size_t cache_line_size = 64;
+
+namespace partition_detail {
+
+// Boundaries give the number of parts, and the index at which each part
+// starts. Part k is [boundary(k), boundary(k + 1)), boundary(0) is 0 and
+// boundary(parts()) is the size of the whole range.
+
+// Parts of n elements, except for the last one, which might be shorter.
+struct fixed_size {
+	std::size_t size;
+	std::size_t n;
+
+	constexpr std::size_t parts() const { return (size + n - 1) / n; }
+
+	constexpr std::size_t boundary(std::size_t k) const {
+		return k < parts() ? k * n : size;
+	}
+};
+
+// parts parts, of which the sizes differ at most one element. The longer ones
+// come first.
+struct even {
+	std::size_t size;
+	std::size_t n;
+
+	constexpr std::size_t parts() const { return n; }
+
+	constexpr std::size_t boundary(std::size_t k) const {
+		return k * (size / n) + (k < size % n ? k : size % n);
+	}
+};
+
+// Like even, but every boundary moved back to the first element that starts
+// on a new cache line, when possible.
+struct cache_aligned {
+	even parts_;
+	std::uintptr_t address;
+	std::size_t element_size;
+
+	constexpr std::size_t parts() const { return parts_.parts(); }
+
+	std::size_t boundary(std::size_t k) const {
+		std::size_t i = parts_.boundary(k);
+		if (k == 0 || k == parts()) return i;
+		std::uintptr_t line = (address + i * element_size) & ~std::uintptr_t(cache_line_size - 1);
+		if (line <= address) return 0;
+		return (line - address + element_size - 1) / element_size;
+	}
+};
+
+}
+
+// A sequence of consecutive parts of a range, as made by chunks(),
+// split_even() and partition_for_threads().
+//
+// The parts are subranges of the original range, which must outlive the
+// partition_view. They are computed when accessed, and can be accessed in
+// any order, such that part i can be handed to worker number i.
+template<typename T, typename Boundaries>
+class partition_view {
+
+	range<T> input_;
+	Boundaries boundaries_;
+
+public:
+	class iterator {
+		partition_view const * view_;
+		std::size_t index_;
+
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type        = range<T>;
+		using difference_type   = std::ptrdiff_t;
+		using pointer           = void;
+		using reference         = range<T>;
+
+		iterator() : view_(nullptr), index_(0) {}
+
+		iterator(partition_view const * view, std::size_t index) : view_(view), index_(index) {}
+
+		range<T> operator * () const { return (*view_)[index_]; }
+
+		iterator & operator ++ () {
+			++index_;
+			return *this;
+		}
+
+		iterator operator ++ (int) {
+			iterator old = *this;
+			++index_;
+			return old;
+		}
+
+		// The index of the current part.
+		std::size_t index() const { return index_; }
+
+		friend bool operator == (iterator const & a, iterator const & b) { return a.index_ == b.index_; }
+		friend bool operator != (iterator const & a, iterator const & b) { return a.index_ != b.index_; }
+	};
+
+	partition_view(range<T> input, Boundaries boundaries) : input_(input), boundaries_(boundaries) {}
+
+	// The number of parts.
+	std::size_t size() const { return boundaries_.parts(); }
+
+	bool empty() const { return size() == 0; }
+
+	range<T> operator [] (std::size_t i) const {
+		assert(i < size());
+		std::size_t b = boundaries_.boundary(i);
+		std::size_t e = boundaries_.boundary(i + 1);
+		return {input_.data() + b, e - b};
+	}
+
+	iterator begin() const { return iterator(this, 0); }
+	iterator   end() const { return iterator(this, size()); }
+};
+
+// Splits r into parts of n elements. The last part is shorter if the size of
+// r is not a multiple of n. An empty r gives no parts.
+//
+// Example:
+//   for (mstd::range<float> block : mstd::chunks(samples, 1024)) {
+//     ...
+//   }
+template<typename T>
+partition_view<T, partition_detail::fixed_size> chunks(range<T> r, std::size_t n) {
+	assert(n > 0);
+	return {r, partition_detail::fixed_size{r.size(), n}};
+}
+
+// Splits r into exactly parts parts, of which the sizes differ at most one
+// element. If r has fewer than parts elements, the last parts are empty.
+template<typename T>
+partition_view<T, partition_detail::even> split_even(range<T> r, std::size_t parts) {
+	assert(parts > 0);
+	return {r, partition_detail::even{r.size(), parts}};
+}
+
+// Splits r into nthreads parts for that many threads to work on.
+//
+// Like split_even(), but every part (except the first) starts at the start
+// of a cache line, such that threads writing to the elements of adjacent
+// parts do not slow each other down by writing to the same cache line (false
+// sharing). This makes the sizes differ by up to a cache line. Parts of a
+// small r can be empty.
+//
+// If an element size doesn't divide the cache line size, or r isn't aligned
+// to its element size, parts start at the first element that starts on a
+// new cache line instead.
+template<typename T>
+partition_view<T, partition_detail::cache_aligned> partition_for_threads(range<T> r, std::size_t nthreads) {
+	assert(nthreads > 0);
+	return {r, partition_detail::cache_aligned{
+		partition_detail::even{r.size(), nthreads},
+		reinterpret_cast<std::uintptr_t>(r.data()),
+		sizeof(T)
+	}};
+}
+
+}
@@ -1,6 +1,9 @@
 #pragma once
 
+#include <cassert>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <initializer_list>
 #include <type_traits>
 
@@ -9,77 +12,372 @@ namespace mstd {
 namespace range_detail {
 
 template<typename T>
-auto data(T & v) -> decltype(v.data()) { return v.data(); }
+constexpr auto data(T & v) -> decltype(v.data()) { return v.data(); }
 
 template<typename T>
-T const * data(std::initializer_list<T> v) { return v.begin(); }
+constexpr T const * data(std::initializer_list<T> v) { return v.begin(); }
 
 template<typename T, size_t N>
-T * data(T (&x)[N]) { return x; }
+constexpr T * data(T (&x)[N]) { return x; }
 
 template<typename T>
-auto size(T & v) -> decltype(v.size()) { return v.size(); }
+constexpr auto size(T & v) -> decltype(v.size()) { return v.size(); }
 
 template<typename T, size_t N>
-size_t size(T (&)[N]) { return N; }
+constexpr size_t size(T (&)[N]) { return N; }
 
+// Whether this is evaluated at compile time, in which case the fast paths
+// using memcmp and memchr can't be used.
+// Without a way to tell, this always returns true.
+constexpr bool is_constant_evaluated() noexcept {
+#if defined(__cpp_lib_is_constant_evaluated)
+	return std::is_constant_evaluated();
+#elif defined(__clang__)
+#if __has_builtin(__builtin_is_constant_evaluated)
+	return __builtin_is_constant_evaluated();
+#else
+	return true;
+#endif
+#elif defined(__GNUC__) && __GNUC__ >= 9
+	return __builtin_is_constant_evaluated();
+#else
+	return true;
+#endif
 }
 
+// Whether T == T compares the bytes of the objects, such that memcmp and
+// memchr can be used instead.
 template<typename T>
-struct range {
+struct is_bytewise_comparable : std::integral_constant<bool,
+	std::is_integral<T>::value || std::is_enum<T>::value || std::is_pointer<T>::value
+> {};
 
-	constexpr range() : begin_(nullptr), size_(0) {}
+template<typename A, typename B>
+struct use_memcmp : std::integral_constant<bool,
+	std::is_same<typename std::remove_cv<A>::type, typename std::remove_cv<B>::type>::value &&
+	is_bytewise_comparable<typename std::remove_cv<A>::type>::value
+> {};
 
-	constexpr range(decltype(nullptr)) : begin_(nullptr), size_(0) {}
+template<typename T>
+struct use_memchr : std::integral_constant<bool,
+	sizeof(T) == 1 && is_bytewise_comparable<typename std::remove_cv<T>::type>::value
+> {};
+
+template<typename A, typename B>
+constexpr bool equal(A * a, B * b, std::size_t n) {
+	if (use_memcmp<A, B>::value && !is_constant_evaluated()) {
+		return n == 0 || std::memcmp(a, b, n * sizeof(A)) == 0;
+	}
+	for (std::size_t i = 0; i < n; ++i) if (!(a[i] == b[i])) return false;
+	return true;
+}
+
+// The index of the first element that differs, or n.
+template<typename A, typename B>
+constexpr std::size_t mismatch(A * a, B * b, std::size_t n) {
+	std::size_t i = 0;
+	if (use_memcmp<A, B>::value && !is_constant_evaluated()) {
+		// Skip the blocks that are equal, then find the element below.
+		constexpr std::size_t block = 64 / sizeof(A);
+		while (n - i >= block && std::memcmp(a + i, b + i, block * sizeof(A)) == 0) i += block;
+	}
+	while (i < n && a[i] == b[i]) ++i;
+	return i;
+}
+
+// The index of the first element equal to x, or std::size_t(-1).
+template<typename T>
+constexpr std::size_t find(T * p, std::size_t n, typename std::remove_cv<T>::type const & x, std::false_type) {
+	for (std::size_t i = 0; i < n; ++i) if (p[i] == x) return i;
+	return std::size_t(-1);
+}
 
-	constexpr range(T * b, std::size_t s) : begin_(b), size_(s) {}
+template<typename T>
+constexpr std::size_t find(T * p, std::size_t n, typename std::remove_cv<T>::type const & x, std::true_type) {
+	if (is_constant_evaluated()) return find(p, n, x, std::false_type());
+	if (n == 0) return std::size_t(-1);
+	auto r = static_cast<T const *>(std::memchr(p, static_cast<unsigned char>(x), n));
+	return r ? std::size_t(r - p) : std::size_t(-1);
+}
 
-	constexpr range(T * b, T * e) : begin_(b), size_(e - b) {}
+// The index of the first occurrence of the m elements of needle in the n
+// elements of p, or std::size_t(-1). Needs 0 < m <= n.
+//
+// Finds the first element of the needle, and then compares the rest.
+template<typename T, typename UseMemchr>
+constexpr std::size_t search_first(T * p, std::size_t n, typename std::remove_cv<T>::type const * needle, std::size_t m, UseMemchr) {
+	for (std::size_t i = 0; n - i >= m; ++i) {
+		std::size_t j = find(p + i, n - m + 1 - i, needle[0], UseMemchr());
+		if (j == std::size_t(-1)) break;
+		i += j;
+		if (equal(p + i + 1, needle + 1, m - 1)) return i;
+	}
+	return std::size_t(-1);
+}
+
+template<typename T>
+constexpr std::size_t search(T * p, std::size_t n, typename std::remove_cv<T>::type const * needle, std::size_t m, std::false_type) {
+	return search_first(p, n, needle, m, std::false_type());
+}
+
+// Compares the first and last byte of the needle at every position, and only
+// then the rest.
+inline std::size_t search_ends(unsigned char const * p, std::size_t n, unsigned char const * needle, std::size_t m) noexcept {
+	unsigned char first = needle[0];
+	unsigned char last = needle[m - 1];
+	for (std::size_t i = 0; i + m <= n; ++i) {
+		if (p[i] == first && p[i + m - 1] == last && std::memcmp(p + i + 1, needle + 1, m - 2) == 0) return i;
+	}
+	return std::size_t(-1);
+}
+
+// Finds the last byte of the needle with memchr, and compares the rest with
+// memcmp. That quickly skips over everything without that byte, but a call
+// for every candidate is slow when it is common. So when more than one in 32
+// bytes turns out to be a false candidate, this continues with search_ends.
+inline std::size_t search_bytes(unsigned char const * p, std::size_t n, unsigned char const * needle, std::size_t m) noexcept {
+	unsigned char last = needle[m - 1];
+	std::size_t misses = 0;
+	// The position of the last byte of the candidate.
+	for (std::size_t i = m - 1; i < n; ++i) {
+		auto q = static_cast<unsigned char const *>(std::memchr(p + i, last, n - i));
+		if (!q) break;
+		i = std::size_t(q - p);
+		std::size_t start = i - (m - 1);
+		if (std::memcmp(p + start, needle, m - 1) == 0) return start;
+		if (++misses * 32 > i + 256) {
+			std::size_t r = search_ends(p + start + 1, n - start - 1, needle, m);
+			return r == std::size_t(-1) ? r : start + 1 + r;
+		}
+	}
+	return std::size_t(-1);
+}
 
-	constexpr range(T & x) : begin_(&x), size_(1) {}
+template<typename T>
+constexpr std::size_t search(T * p, std::size_t n, typename std::remove_cv<T>::type const * needle, std::size_t m, std::true_type) {
+	if (is_constant_evaluated() || m == 1) return search_first(p, n, needle, m, std::true_type());
+	return search_bytes(
+		reinterpret_cast<unsigned char const *>(p), n,
+		reinterpret_cast<unsigned char const *>(needle), m
+	);
+}
+
+}
+
+// Used as Extent for ranges of which the size is only known at run time.
+constexpr std::size_t dynamic_extent = std::size_t(-1);
+
+template<typename T, std::size_t Extent = dynamic_extent, std::size_t Align = 0>
+struct range;
+
+namespace range_detail {
+
+template<typename T>
+struct is_range : std::false_type {};
+
+template<typename T, std::size_t Extent, std::size_t Align>
+struct is_range<range<T, Extent, Align>> : std::true_type {};
+
+// The size of a range, which is only stored if it is not known at compile
+// time.
+template<std::size_t Extent>
+struct extent_storage {
+	static constexpr std::size_t size_ = Extent;
+	constexpr explicit extent_storage(std::size_t) {}
+};
+
+template<>
+struct extent_storage<dynamic_extent> {
+	std::size_t size_;
+	constexpr explicit extent_storage(std::size_t s) : size_(s) {}
+};
+
+template<std::size_t Align, typename T>
+constexpr T * assume_aligned(T * p) {
+#if defined(__GNUC__) || defined(__clang__)
+	if (!is_constant_evaluated()) return static_cast<T *>(__builtin_assume_aligned(p, Align));
+#endif
+	return p;
+}
+
+template<std::size_t Align, typename T>
+constexpr bool is_aligned(T * p) {
+	return is_constant_evaluated() || reinterpret_cast<std::uintptr_t>(p) % Align == 0;
+}
+
+}
+
+// A range of Extent elements starting at an address that is a multiple of
+// Align.
+//
+// By default, the size is only known at run time, and the alignment is that of
+// T. Otherwise, the size and alignment are part of the type, which lets the
+// compiler unroll loops over it and use aligned loads and stores:
+//
+//   std::uint64_t checksum(mstd::range<std::uint8_t const, 64, 64> block);
+//
+// A range converts implicitly to a range with a dynamic extent or a weaker
+// alignment. The other way around, (pointer, size) constructors or first<N>()
+// can be used, which assert that the size and alignment are right.
+template<typename T, std::size_t Extent, std::size_t Align>
+struct range : private range_detail::extent_storage<Extent> {
+
+private:
+	using storage = range_detail::extent_storage<Extent>;
+	using storage::size_;
+
+	static_assert(Align == 0 || (Align & (Align - 1)) == 0, "Align must be zero or a power of two");
+
+public:
+	// Returned by find() if nothing was found.
+	static constexpr std::size_t npos = std::size_t(-1);
+
+	static constexpr std::size_t extent = Extent;
+
+	// The alignment of the first element, at least alignof(T).
+	static constexpr std::size_t alignment() {
+		return Align > alignof(T) ? Align : alignof(T);
+	}
+
+	constexpr range() : storage(0), begin_(nullptr) {
+		static_assert(Extent == dynamic_extent || Extent == 0, "a range with a fixed extent can't be empty");
+	}
+
+	constexpr range(decltype(nullptr)) : storage(0), begin_(nullptr) {
+		static_assert(Extent == dynamic_extent || Extent == 0, "a range with a fixed extent can't be empty");
+	}
+
+	constexpr range(T * b, std::size_t s) : storage(s), begin_(b) {
+		assert(Extent == dynamic_extent || s == Extent);
+		assert(range_detail::is_aligned<alignment()>(b));
+	}
+
+	constexpr range(T * b, T * e) : range(b, std::size_t(e - b)) {}
+
+	constexpr range(T & x) : range(&x, 1) {}
 
 	template<
 		typename X,
 		typename = std::enable_if_t<
+			!range_detail::is_range<typename std::remove_cv<X>::type>::value &&
 			std::is_convertible<decltype(range_detail::data(std::declval<X &>())), T *>::value &&
 			std::is_convertible<decltype(range_detail::size(std::declval<X &>())), std::size_t>::value
 		>
 	>
-	constexpr range(X & x) : begin_(range_detail::data(x)), size_(range_detail::size(x)) {}
+	constexpr range(X & x) : range(range_detail::data(x), range_detail::size(x)) {}
+
+	// From a range with the same or a fixed extent, and the same or a
+	// stronger alignment.
+	template<
+		typename T2,
+		std::size_t Extent2,
+		std::size_t Align2,
+		typename = std::enable_if_t<
+			std::is_convertible<T2 *, T *>::value &&
+			(Extent == dynamic_extent || Extent == Extent2) &&
+			range<T2, Extent2, Align2>::alignment() >= alignment()
+		>
+	>
+	constexpr range(range<T2, Extent2, Align2> r) : storage(r.size()), begin_(r.data()) {}
+
+	constexpr T & operator [] (std::size_t i) const { return aligned_begin()[i]; }
 
-	constexpr T & operator [] (std::size_t i) const { return begin_[i]; }
+	constexpr T * begin() const { return aligned_begin(); }
+	constexpr T *   end() const { return aligned_begin() + size_; }
 
-	constexpr T * begin() const { return begin_; }
-	constexpr T *   end() const { return begin_ + size_; }
+	constexpr void remove_prefix(std::size_t n) {
+		static_assert(Extent == dynamic_extent && Align == 0, "remove_prefix would change the extent or alignment");
+		begin_ += n;
+		size_ -= n;
+	}
 
-	constexpr void remove_prefix(std::size_t n) { begin_ += n; size_ -= n; }
-	constexpr void remove_suffix(std::size_t n) { size_ -= n; }
+	constexpr void remove_suffix(std::size_t n) {
+		static_assert(Extent == dynamic_extent, "remove_suffix would change the extent");
+		size_ -= n;
+	}
 
 	constexpr std::size_t size() const { return size_; }
 
-	constexpr T * data() const { return begin_; }
+	constexpr T * data() const { return aligned_begin(); }
 
 	constexpr bool empty() const { return size_ == 0; }
 
-	constexpr range subrange(std::size_t pos, std::size_t count = std::size_t(-1)) {
-		return range(begin_ + pos, size_ - pos < count ? size_ - pos : count);
+	constexpr range<T> subrange(std::size_t pos, std::size_t count = std::size_t(-1)) {
+		return range<T>(begin_ + pos, size_ - pos < count ? size_ - pos : count);
+	}
+
+	// The first N elements, as a range with a fixed extent.
+	template<std::size_t N>
+	constexpr range<T, N, Align> first() const {
+		assert(N <= size_);
+		return {begin_, N};
+	}
+
+	// The index of the first element equal to x, starting at pos, or npos.
+	constexpr std::size_t find(T const & x, std::size_t pos = 0) const {
+		if (pos >= size_) return npos;
+		std::size_t i = range_detail::find(begin_ + pos, size_ - pos, x, range_detail::use_memchr<T>());
+		return i == npos ? npos : pos + i;
+	}
+
+	// The index of the first occurrence of needle, starting at pos, or npos.
+	constexpr std::size_t find(range<T const> needle, std::size_t pos = 0) const {
+		if (needle.empty()) return pos <= size_ ? pos : npos;
+		if (pos >= size_ || size_ - pos < needle.size()) return npos;
+		std::size_t i = range_detail::search(begin_ + pos, size_ - pos, needle.begin(), needle.size(), range_detail::use_memchr<T>());
+		return i == npos ? npos : pos + i;
+	}
+
+	// The index of the first element that differs from the one in other, or
+	// the size of the shortest of the two if one starts with the other.
+	constexpr std::size_t mismatch(range<T const> other) const {
+		return range_detail::mismatch(begin_, other.begin(), size_ < other.size() ? size_ : other.size());
+	}
+
+	constexpr bool starts_with(range<T const> prefix) const {
+		return size_ >= prefix.size() && range_detail::equal(begin_, prefix.begin(), prefix.size());
+	}
+
+	constexpr bool ends_with(range<T const> suffix) const {
+		return size_ >= suffix.size() && range_detail::equal(begin_ + (size_ - suffix.size()), suffix.begin(), suffix.size());
 	}
 
+	// Byte-wise comparable elements, like integers and enums, are compared
+	// using memcmp, except at compile time.
+
 	friend constexpr bool operator == (range a, range b) {
 		if (a.size() != b.size()) return false;
-		for (size_t i = 0; i < a.size(); ++i) if (!(a[i] == b[i])) return false;
-		return true;
+		return range_detail::equal(a.begin(), b.begin(), a.size());
 	}
 
 	friend constexpr bool operator != (range a, range b) {
 		if (a.size() != b.size()) return true;
+		if (range_detail::use_memcmp<T, T>::value) return !range_detail::equal(a.begin(), b.begin(), a.size());
 		for (size_t i = 0; i < a.size(); ++i) if (a[i] != b[i]) return true;
 		return false;
 	}
 
 private:
 	T * begin_;
-	std::size_t size_;
+
+	constexpr T * aligned_begin() const {
+		return Align > alignof(T) ? range_detail::assume_aligned<alignment()>(begin_) : begin_;
+	}
 };
 
+#if __cplusplus < 201703L
+template<typename T, std::size_t Extent, std::size_t Align>
+constexpr std::size_t range<T, Extent, Align>::npos;
+
+template<typename T, std::size_t Extent, std::size_t Align>
+constexpr std::size_t range<T, Extent, Align>::extent;
+
+template<std::size_t Extent>
+constexpr std::size_t range_detail::extent_storage<Extent>::size_;
+#endif
+
+// A range of which the first element is aligned to Align bytes.
+template<typename T, std::size_t Align>
+using aligned_range = range<T, dynamic_extent, Align>;
+
 }
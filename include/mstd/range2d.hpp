@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <type_traits>
+
+#include "range.hpp"
+#include "strided_range.hpp"
+
+namespace mstd {
+
+// A two-dimensional view of rows() by cols() elements, where each row is
+// contiguous and rows start pitch() elements apart. For example an image, a
+// matrix, or a part of one.
+//
+// Example:
+//   void blur(mstd::range2d<float const> in, mstd::range2d<float> out) {
+//     in.for_each_tile(64, 64, [&] (mstd::range2d<float const> tile, std::size_t row, std::size_t col) {
+//       ...
+//     });
+//   }
+template<typename T>
+struct range2d {
+
+	constexpr range2d() : data_(nullptr), rows_(0), cols_(0), pitch_(0) {}
+
+	constexpr range2d(decltype(nullptr)) : data_(nullptr), rows_(0), cols_(0), pitch_(0) {}
+
+	constexpr range2d(T * data, std::size_t rows, std::size_t cols)
+		: data_(data), rows_(rows), cols_(cols), pitch_(cols) {}
+
+	constexpr range2d(T * data, std::size_t rows, std::size_t cols, std::size_t pitch)
+		: data_(data), rows_(rows), cols_(cols), pitch_(pitch) {}
+
+	// The elements of r as rows of cols elements.
+	// A partial row at the end is not included.
+	constexpr range2d(range<T> r, std::size_t cols)
+		: data_(r.data()), rows_(cols ? r.size() / cols : 0), cols_(cols), pitch_(cols) {}
+
+	template<
+		typename T2,
+		typename = std::enable_if_t<std::is_convertible<T2 *, T *>::value>
+	>
+	constexpr range2d(range2d<T2> r) : data_(r.data()), rows_(r.rows()), cols_(r.cols()), pitch_(r.pitch()) {}
+
+	constexpr T & operator () (std::size_t row, std::size_t col) const { return data_[row * pitch_ + col]; }
+
+	constexpr range<T> row(std::size_t i) const { return {data_ + i * pitch_, cols_}; }
+
+	constexpr strided_range<T> column(std::size_t j) const {
+		return {data_ + j, rows_, std::ptrdiff_t(pitch_)};
+	}
+
+	constexpr std::size_t rows() const { return rows_; }
+	constexpr std::size_t cols() const { return cols_; }
+
+	// The distance between the starts of two rows, in elements.
+	constexpr std::size_t pitch() const { return pitch_; }
+
+	constexpr std::size_t size() const { return rows_ * cols_; }
+
+	constexpr bool empty() const { return rows_ == 0 || cols_ == 0; }
+
+	// The first element.
+	constexpr T * data() const { return data_; }
+
+	// The part of rows rows and cols columns, starting at (row, col).
+	// Like range::subrange, the size is limited to what is available.
+	constexpr range2d subview(
+		std::size_t row, std::size_t col,
+		std::size_t rows = std::size_t(-1), std::size_t cols = std::size_t(-1)
+	) const {
+		return range2d(
+			data_ + row * pitch_ + col,
+			rows_ - row < rows ? rows_ - row : rows,
+			cols_ - col < cols ? cols_ - col : cols,
+			pitch_
+		);
+	}
+
+	// Whether there is no space between rows, such that this can be converted
+	// to a range<T>.
+	constexpr bool contiguous() const { return pitch_ == cols_ || rows_ <= 1; }
+
+	constexpr range<T> as_range() const {
+		assert(contiguous());
+		return {data_, size()};
+	}
+
+	// Number of tiles of tile_rows by tile_cols needed to cover the view,
+	// vertically and horizontally.
+	constexpr std::size_t row_tiles(std::size_t tile_rows) const { return (rows_ + tile_rows - 1) / tile_rows; }
+	constexpr std::size_t col_tiles(std::size_t tile_cols) const { return (cols_ + tile_cols - 1) / tile_cols; }
+
+	// Tile (i, j) of tile_rows by tile_cols. The tiles at the bottom and
+	// right edges are smaller if the size isn't a multiple of the tile size.
+	constexpr range2d tile(std::size_t i, std::size_t j, std::size_t tile_rows, std::size_t tile_cols) const {
+		return subview(i * tile_rows, j * tile_cols, tile_rows, tile_cols);
+	}
+
+	// Calls f(tile, row, col) for every tile of tile_rows by tile_cols, row
+	// by row, where (row, col) is the position of the first element of the
+	// tile.
+	template<typename F>
+	void for_each_tile(std::size_t tile_rows, std::size_t tile_cols, F && f) const {
+		for (std::size_t row = 0; row < rows_; row += tile_rows) {
+			for (std::size_t col = 0; col < cols_; col += tile_cols) {
+				f(subview(row, col, tile_rows, tile_cols), row, col);
+			}
+		}
+	}
+
+private:
+	T * data_;
+	std::size_t rows_;
+	std::size_t cols_;
+	std::size_t pitch_;
+};
+
+}
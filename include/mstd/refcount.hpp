@@ -1,44 +1,539 @@
 #pragma once
 
 #include <atomic>
+#include <cassert>
 #include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
 #include <memory>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <typeinfo>
 #include <utility>
 
+#include "instrument.hpp"
+#include "range.hpp"
+
 namespace mstd {
 
-class refcounted {
-	mutable std::atomic<std::size_t> references{1};
+namespace refcount_detail {
+
+// The highest bit of a reference count is not part of the count. It marks
+// objects created by allocate_refcount.
+constexpr std::size_t allocated = ~(std::size_t(-1) >> 1);
+
+// Calls f on destruction, unless dismissed. For undoing work when a
+// constructor throws, without try/catch, which doesn't compile with
+// -fno-exceptions.
+template<typename F>
+class unwind_guard {
+	F f_;
+	bool active_ = true;
 
 public:
-	refcounted() noexcept {}
+	explicit unwind_guard(F f) : f_(std::move(f)) {}
+
+	unwind_guard(unwind_guard && other) : f_(std::move(other.f_)), active_(other.active_) { other.active_ = false; }
+
+	unwind_guard & operator = (unwind_guard &&) = delete;
+
+	~unwind_guard() { if (active_) f_(); }
+
+	void dismiss() noexcept { active_ = false; }
+};
+
+template<typename F>
+unwind_guard<F> on_unwind(F f) { return unwind_guard<F>(std::move(f)); }
+
+}
+
+// Reference counting policies for basic_refcounted.
+//
+// A policy provides a counter type, which starts at one reference, and static
+// load, increment and decrement functions operating on it. Both increment and
+// decrement take the number of references to add or remove (one by default),
+// and return the new number of references. When decrement returns zero,
+// everything other owners did before dropping their references must be
+// visible to the calling thread, since it is about to destroy the object.
+//
+// The highest bit of the count is used as a flag by basic_refcounted. A policy
+// must not touch it, other than by adding it to the count with increment(),
+// and must ignore it when checking for the last reference.
+//
+// Thread safe policies also provide handoff(), which is called before an
+// object is shared with other threads. See biased_refcount.
+
+// Thread safe reference counting.
+//
+// A new reference can only be made from an existing one, so incrementing does
+// not need to order anything. Decrementing releases, and only the thread that
+// drops the last reference acquires, right before the object is destroyed.
+// load() acquires, such that a use count of one means that all other (former)
+// owners are done with the object.
+struct atomic_refcount {
+	using counter = std::atomic<std::size_t>;
+
+	static std::size_t load(counter const & c) noexcept {
+		return c.load(std::memory_order_acquire);
+	}
+
+	static std::size_t increment(counter & c, std::size_t n = 1) noexcept {
+		return c.fetch_add(n, std::memory_order_relaxed) + n;
+	}
+
+	static std::size_t decrement(counter & c, std::size_t n = 1) noexcept {
+		std::size_t n_refs = c.fetch_sub(n, std::memory_order_release) - n;
+		if (!(n_refs & ~refcount_detail::allocated)) std::atomic_thread_fence(std::memory_order_acquire);
+		return n_refs;
+	}
+
+	static void handoff(counter &) noexcept {}
+};
+
+// Reference counting for objects that never leave their thread.
+//
+// A plain integer, which allows the compiler to combine or entirely remove
+// back-to-back increments and decrements.
+struct local_refcount {
+	using counter = std::size_t;
+
+	static std::size_t load(counter const & c) noexcept {
+		return c;
+	}
+
+	static std::size_t increment(counter & c, std::size_t n = 1) noexcept {
+		return c += n;
+	}
+
+	static std::size_t decrement(counter & c, std::size_t n = 1) noexcept {
+		return c -= n;
+	}
+};
+
+// Reference counting biased towards the thread that created the object.
+//
+// The creating thread (the owner) counts its references in a plain integer,
+// without any atomic operations. Before the object is shared with any other
+// thread, the owner must call handoff() (e.g. through refcount_ptr::handoff()),
+// which merges the owner's count into the atomic shared count. From then on,
+// all threads, including the former owner, count atomically, exactly like
+// atomic_refcount.
+//
+// This is useful for objects that are created and used by one thread, and
+// only sometimes passed on to other threads.
+//
+// A missing handoff() can't be repaired by the other thread, since the owner
+// might be using its count at the same time. Instead, it is always detected
+// (also with NDEBUG) when another thread first counts a reference, which
+// aborts the program with a message.
+struct biased_refcount {
+	struct counter {
+		explicit counter(std::size_t n) noexcept : biased(n), shared(0) {}
+
+		std::thread::id owner = std::this_thread::get_id();
+		std::size_t biased;
+		std::atomic<std::size_t> shared;
+	};
+
+	static bool owned(counter const & c) noexcept {
+		return c.owner == std::this_thread::get_id();
+	}
+
+	static std::size_t load(counter const & c) noexcept {
+		if (owned(c)) return c.biased;
+		return atomic_refcount::load(c.shared);
+	}
+
+	static std::size_t increment(counter & c, std::size_t n = 1) noexcept {
+		if (owned(c)) return c.biased += n;
+		if (c.owner != std::thread::id()) missing_handoff();
+		return atomic_refcount::increment(c.shared, n);
+	}
+
+	static std::size_t decrement(counter & c, std::size_t n = 1) noexcept {
+		if (owned(c)) return c.biased -= n;
+		if (c.owner != std::thread::id()) missing_handoff();
+		return atomic_refcount::decrement(c.shared, n);
+	}
+
+	// Must be called by the owner, or after the object was already handed off.
+	static void handoff(counter & c) noexcept {
+		if (!owned(c)) return;
+		c.shared.store(c.biased, std::memory_order_relaxed);
+		c.owner = std::thread::id();
+	}
+
+	[[noreturn]] static void missing_handoff() noexcept;
+};
+
+// Kept out of line, to keep it out of the code counting references.
+#if defined(__GNUC__) || defined(__clang__)
+__attribute__((noinline, cold))
+#endif
+[[noreturn]] inline void biased_refcount::missing_handoff() noexcept {
+	std::fputs("mstd::biased_refcount: object used by another thread without handoff()\n", stderr);
+	std::abort();
+}
+
+// Thread safe reference counting with support for weak references.
+//
+// The strong and weak counts are stored outside of the object, in front of it
+// in the same allocation, such that they can outlive the object. The object
+// itself only points to them. Therefore, objects using this policy must be
+// created by make_refcount or allocate_refcount.
+struct weak_refcount {
+	struct counts {
+		std::atomic<std::size_t> strong{1};
+		// The number of weak references, plus one for all strong references.
+		std::atomic<std::size_t> weak{1};
+	};
+
+	struct counter {
+		explicit counter(std::size_t) noexcept {}
+
+		counts * counts_ = nullptr;
+	};
+
+	static std::size_t load(counter const & c) noexcept {
+		assert(c.counts_ && "weak_refcount: object not created by make_refcount or allocate_refcount");
+		return atomic_refcount::load(c.counts_->strong);
+	}
+
+	static std::size_t increment(counter & c, std::size_t n = 1) noexcept {
+		assert(c.counts_ && "weak_refcount: object not created by make_refcount or allocate_refcount");
+		return atomic_refcount::increment(c.counts_->strong, n);
+	}
+
+	static std::size_t decrement(counter & c, std::size_t n = 1) noexcept {
+		assert(c.counts_ && "weak_refcount: object not created by make_refcount or allocate_refcount");
+		return atomic_refcount::decrement(c.counts_->strong, n);
+	}
 
-	refcounted(refcounted const &) noexcept {}
-	refcounted(refcounted &&) noexcept {}
+	static void handoff(counter &) noexcept {}
 
-	refcounted & operator=(refcounted const &) noexcept { return *this; }
-	refcounted & operator=(refcounted &&) noexcept { return *this; }
+	// Adds a strong reference, unless there are none left.
+	static bool try_increment(counts & c) noexcept {
+		std::size_t n_refs = c.strong.load(std::memory_order_relaxed);
+		do {
+			if (!(n_refs & ~refcount_detail::allocated)) return false;
+		} while (!c.strong.compare_exchange_weak(n_refs, n_refs + 1, std::memory_order_relaxed));
+		return true;
+	}
+};
+
+template<typename Policy> class basic_refcounted;
+
+namespace refcount_detail {
+
+struct access {
+	template<typename Policy>
+	static typename Policy::counter & references(basic_refcounted<Policy> const * object) noexcept {
+		return object->references;
+	}
+
+	template<typename Policy>
+	static void mark_allocated(basic_refcounted<Policy> const * object) noexcept {
+		Policy::increment(object->references, allocated);
+	}
+
+	// Adds n references that nobody owns yet, and which are not reported
+	// to instrumentation. They must be dropped again by drop().
+	// (Used by atomic_refcount_ptr.)
+	template<typename Policy>
+	static void reserve(basic_refcounted<Policy> const * object, std::size_t n) noexcept {
+		Policy::increment(object->references, n);
+	}
+
+	// Drops n references, plus the given number of reserved ones, with a
+	// single decrement.
+	template<typename Policy, typename T>
+	static std::size_t drop(T const * object, std::size_t n, std::size_t reserved) noexcept {
+		return basic_refcounted<Policy>::drop(object, n, reserved);
+	}
+
+	// Drops a reference that is known not to be the last one, so without the
+	// code for destroying the object. (Which also keeps GCC from warning
+	// about the object being used after that.)
+	template<typename Policy, typename T>
+	static void drop_not_last(T const * object) noexcept {
+		auto n_refs = Policy::decrement(static_cast<basic_refcounted<Policy> const *>(object)->references, 1);
+		assert((n_refs & ~allocated) != 0);
+		(void)n_refs;
+#if MSTD_INSTRUMENT
+		instrument_detail::on_decrement<T>(object, 1);
+#endif
+	}
+};
+
+using deallocate_fn = void (*)(void const * object);
+
+template<typename T>
+void const * complete_object(T const * object, std::true_type /* polymorphic */) noexcept {
+	return dynamic_cast<void const *>(object);
+}
+
+template<typename T>
+void const * complete_object(T const * object, std::false_type /* polymorphic */) noexcept {
+	return object;
+}
 
-	friend std::size_t use_count(refcounted const * object) noexcept;
+// The start of the object that was created, which is where the allocation
+// header ends. (Which can differ from object if T is not its first base.)
+template<typename T>
+void const * complete_object(T const * object) noexcept {
+	return complete_object(object, std::is_polymorphic<T>());
+}
 
-	friend std::size_t increment_refcount(refcounted const * object) noexcept {
-		return ++object->references;
+// Drops a weak reference to an object with a weak_refcount.
+// When it was the last one, the allocation, which has the deallocation
+// function right after the counts, is freed.
+inline void release_weak(weak_refcount::counts * counts) noexcept {
+	if (counts->weak.fetch_sub(1, std::memory_order_release) == 1) {
+		std::atomic_thread_fence(std::memory_order_acquire);
+		auto deallocate = reinterpret_cast<deallocate_fn const *>(counts + 1);
+		(*deallocate)(deallocate + 1);
 	}
+}
 
+// The deallocation function of an object made by allocate_refcount, which
+// put it right in front of the object. (Computed as an integer, since GCC
+// otherwise warns about indexing out of bounds, when it sees the same object
+// being created by new on the path where this isn't used.)
+inline deallocate_fn deallocator_of(void const * complete) noexcept {
+	std::uintptr_t p = reinterpret_cast<std::uintptr_t>(complete) - sizeof(deallocate_fn);
+	return *reinterpret_cast<deallocate_fn const *>(p);
+}
+
+// Destroys an object after its last (strong) reference is dropped.
+template<typename Policy>
+struct destroy {
 	template<typename T>
-	friend std::size_t decrement_refcount(T const * object) noexcept {
-		auto n_refs = --static_cast<refcounted const *>(object)->references;
-		if (!n_refs) delete object;
+	static void last(T const * object, bool allocated) noexcept {
+		if (!allocated) {
+			delete object;
+			return;
+		}
+		void const * complete = complete_object(object);
+		auto deallocate = deallocator_of(complete);
+		object->~T();
+		deallocate(complete);
+	}
+};
+
+template<>
+struct destroy<weak_refcount> {
+	template<typename T>
+	static void last(T const * object, bool) noexcept {
+		auto counts = access::references<weak_refcount>(object).counts_;
+		object->~T();
+		release_weak(counts);
+	}
+};
+
+}
+
+// Base class for intrusively reference counted objects.
+//
+// The Policy decides how the references are counted. Types which are never
+// shared between threads can use a policy without any atomic operations.
+template<typename Policy = atomic_refcount>
+class basic_refcounted {
+	mutable typename Policy::counter references{1};
+
+public:
+	using refcount_policy = Policy;
+
+	basic_refcounted() noexcept {}
+
+	basic_refcounted(basic_refcounted const &) noexcept {}
+	basic_refcounted(basic_refcounted &&) noexcept {}
+
+	basic_refcounted & operator=(basic_refcounted const &) noexcept { return *this; }
+	basic_refcounted & operator=(basic_refcounted &&) noexcept { return *this; }
+
+	friend struct refcount_detail::access;
+
+	// Adds or drops n references with a single operation on the count.
+	template<typename T>
+	friend typename std::enable_if<
+		std::is_convertible<T const *, basic_refcounted const *>::value,
+		std::size_t
+	>::type increment_refcount(T const * object, std::size_t n = 1) noexcept {
+		auto n_refs = Policy::increment(static_cast<basic_refcounted const *>(object)->references, n);
+#if MSTD_INSTRUMENT
+		instrument_detail::on_increment<T>(object, n, n_refs & ~refcount_detail::allocated);
+#endif
 		return n_refs;
 	}
+
+	friend void handoff_refcount(basic_refcounted const * object) noexcept {
+		Policy::handoff(object->references);
+	}
+
+	template<typename T>
+	friend typename std::enable_if<
+		std::is_convertible<T const *, basic_refcounted const *>::value,
+		std::size_t
+	>::type decrement_refcount(T const * object, std::size_t n = 1) noexcept {
+		return drop(object, n, 0);
+	}
+
+private:
+	template<typename T>
+	static std::size_t drop(T const * object, std::size_t n, std::size_t reserved) noexcept {
+		auto n_refs = Policy::decrement(static_cast<basic_refcounted const *>(object)->references, n + reserved);
+#if MSTD_INSTRUMENT
+		instrument_detail::on_decrement<T>(object, n);
+#endif
+		if (!(n_refs & ~refcount_detail::allocated)) {
+#if MSTD_INSTRUMENT
+			instrument_detail::on_free<T>(object);
+#endif
+			refcount_detail::destroy<Policy>::last(object, n_refs & refcount_detail::allocated);
+		}
+		return n_refs & ~refcount_detail::allocated;
+	}
 };
 
-inline std::size_t use_count(refcounted const * object) noexcept {
-	return object->references;
+template<typename Policy>
+inline std::size_t use_count(basic_refcounted<Policy> const * object) noexcept {
+	return Policy::load(refcount_detail::access::references(object)) & ~refcount_detail::allocated;
 }
 
+using refcounted = basic_refcounted<>;
+
+// Like refcounted, but without atomic operations. Objects deriving from this
+// (and all refcount_ptrs to them) must stay within a single thread.
+using refcounted_local = basic_refcounted<local_refcount>;
+
+// Like refcounted, but only the thread that created the object gets to count
+// without atomic operations. Use refcount_ptr::handoff() before sharing it.
+using refcounted_biased = basic_refcounted<biased_refcount>;
+
+// Like refcounted, but supports weak_refcount_ptr.
+// Objects deriving from this must be created by make_refcount or
+// allocate_refcount.
+using refcounted_weak = basic_refcounted<weak_refcount>;
+
+namespace refcount_detail {
+
+template<typename Policy>
+std::true_type is_refcounted(basic_refcounted<Policy> const volatile *);
+
+std::false_type is_refcounted(...);
+
+template<typename Policy>
+Policy policy_of(basic_refcounted<Policy> const volatile *);
+
+}
+
+// The counting policy of a type deriving from basic_refcounted<Policy>.
+template<typename T>
+using refcount_policy_of = decltype(refcount_detail::policy_of(std::declval<T *>()));
+
+// Whether T derives from some basic_refcounted<Policy>.
+template<typename T>
+struct is_refcounted : decltype(refcount_detail::is_refcounted(std::declval<T *>())) {};
+
+// Tag to construct a refcount_ptr from a reference that was already counted.
+struct adopt_refcount_t { explicit adopt_refcount_t() = default; };
+constexpr adopt_refcount_t adopt_refcount{};
+
 template<typename T> class refcount_ptr;
+template<typename T> class weak_refcount_ptr;
+template<typename T> class atomic_refcount_ptr;
 template<typename T, typename... Args> refcount_ptr<T> make_refcount(Args &&...);
+template<typename T, typename Alloc, typename... Args> refcount_ptr<T> allocate_refcount(Alloc const &, Args &&...);
+
+template<typename T>
+std::unique_ptr<typename refcount_ptr<T>::refcounted_type> take_or_copy(refcount_ptr<T> &);
+
+namespace refcount_detail {
+
+struct maker;
+
+template<typename Policy>
+bool is_allocated(basic_refcounted<Policy> const * object) noexcept {
+	return Policy::load(access::references(object)) & allocated;
+}
+
+// The state stored in front of an object created by allocate_refcount.
+// The allocator is a base to make it take no space when it is empty.
+// The deallocation function is last, right in front of the object.
+template<typename Alloc, typename Policy>
+struct allocation_header : Alloc {
+	allocation_header(Alloc const & alloc, deallocate_fn deallocate) noexcept
+		: Alloc(alloc), deallocate(deallocate) {}
+
+	void attach(basic_refcounted<Policy> const *) noexcept {}
+
+	deallocate_fn deallocate;
+};
+
+// Objects with a weak_refcount also get their counts in the header.
+template<typename Alloc>
+struct allocation_header<Alloc, weak_refcount> : Alloc {
+	allocation_header(Alloc const & alloc, deallocate_fn deallocate) noexcept
+		: Alloc(alloc), deallocate(deallocate) {}
+
+	void attach(basic_refcounted<weak_refcount> const * object) noexcept {
+		access::references(object).counts_ = &counts;
+	}
+
+	weak_refcount::counts counts;
+	deallocate_fn deallocate;
+};
+
+// A single allocation containing an allocation_header followed by an R.
+template<typename R, typename Alloc>
+struct allocation {
+	using header = allocation_header<Alloc, refcount_policy_of<R>>;
+
+	static_assert(!std::is_final<Alloc>::value, "allocate_refcount does not support final allocators");
+	static_assert(alignof(header) == alignof(deallocate_fn), "allocate_refcount does not support over-aligned allocators");
+	static_assert(alignof(R) >= alignof(header), "alignment of refcounted object too small");
+
+	struct alignas(R) unit { unsigned char bytes[alignof(R)]; };
+
+	using unit_allocator = typename std::allocator_traits<Alloc>::template rebind_alloc<unit>;
+	using traits = std::allocator_traits<unit_allocator>;
+
+	static_assert(std::is_same<typename traits::pointer, unit *>::value, "allocate_refcount does not support fancy pointers");
+
+	static constexpr std::size_t units_for(std::size_t size) { return (size + sizeof(unit) - 1) / sizeof(unit); }
+
+	static constexpr std::size_t header_units = units_for(sizeof(header));
+	static constexpr std::size_t total_units = header_units + units_for(sizeof(R));
+
+	static header * header_of(void const * object) noexcept {
+		return reinterpret_cast<header *>(const_cast<char *>(static_cast<char const *>(object)) - sizeof(header));
+	}
+
+	template<typename... Args>
+	static R * create(Alloc const & alloc, Args &&... args) {
+		unit_allocator a(alloc);
+		unit * block = traits::allocate(a, total_units);
+		auto guard = on_unwind([&] { traits::deallocate(a, block, total_units); });
+		R * object = ::new (static_cast<void *>(block + header_units)) R(std::forward<Args>(args)...);
+		guard.dismiss();
+		header * h = ::new (static_cast<void *>(header_of(object))) header(alloc, &deallocate);
+		h->attach(object);
+		access::mark_allocated(object);
+		return object;
+	}
+
+	static void deallocate(void const * object) {
+		header * h = header_of(object);
+		unit_allocator a(static_cast<Alloc const &>(*h));
+		h->~header();
+		unit * block = reinterpret_cast<unit *>(const_cast<void *>(object)) - header_units;
+		traits::deallocate(a, block, total_units);
+	}
+};
+
+}
 
 template<typename T>
 class refcount_wrapper final : public refcounted {
@@ -51,12 +546,133 @@ class refcount_wrapper final : public refcounted {
 	template<typename>
 	friend class refcount_ptr;
 
-	template<typename T2, typename... Args>
-	friend refcount_ptr<T2> make_refcount(Args &&...);
+	friend struct refcount_detail::maker;
+
+	template<typename T2>
+	friend std::unique_ptr<typename refcount_ptr<T2>::refcounted_type> take_or_copy(refcount_ptr<T2> &);
+
+	template<typename, typename>
+	friend struct refcount_detail::allocation;
 };
 
+namespace refcount_detail {
+
 template<typename T>
-class refcount_ptr {
+using refcounted_type_for = typename std::conditional<
+	mstd::is_refcounted<typename std::remove_const<T>::type>::value,
+	typename std::remove_const<T>::type,
+	refcount_wrapper<typename std::remove_const<T>::type>
+>::type;
+
+// What refcount_ptr<T> and refcount_ptr<T[]> (the Derived class) have in
+// common: owning a reference to an R, or nothing.
+template<typename Derived, typename R>
+class refcount_ptr_base {
+
+protected:
+	R * object;
+
+	refcount_ptr_base() noexcept : object(nullptr) {}
+
+	explicit refcount_ptr_base(R * object) noexcept : object(object) {
+		if (object) increment_refcount(object);
+	}
+
+	refcount_ptr_base(R * object, adopt_refcount_t) noexcept : object(object) {}
+
+	refcount_ptr_base(refcount_ptr_base const & other) noexcept : refcount_ptr_base(other.object) {}
+
+	refcount_ptr_base(refcount_ptr_base && other) noexcept : object(other.object) {
+		other.object = nullptr;
+	}
+
+	refcount_ptr_base & operator=(refcount_ptr_base const & other) noexcept {
+		assign(other.object);
+		return *this;
+	}
+
+	refcount_ptr_base & operator=(refcount_ptr_base && other) noexcept {
+		if (&other != this) assign_adopted(other.release());
+		return *this;
+	}
+
+	~refcount_ptr_base() noexcept {
+		if (object) decrement_refcount(object);
+	}
+
+	// Points to other, adding a reference to it.
+	void assign(R * other) noexcept {
+		if (other != object) {
+			if (object) decrement_refcount(object);
+			object = other;
+			if (object) increment_refcount(object);
+		}
+	}
+
+	// Points to other, taking over a reference that was already counted.
+	void assign_adopted(R * other) noexcept {
+		if (object) decrement_refcount(object);
+		object = other;
+	}
+
+public:
+	explicit operator bool () const noexcept {
+		return object != nullptr;
+	}
+
+	std::size_t use_count() const noexcept {
+		return object ? mstd::use_count(object) : 0;
+	}
+
+	R * unique() const noexcept {
+		return use_count() == 1 ? object : nullptr;
+	}
+
+	// Gives up the reference, without decrementing the reference count.
+	R * release() noexcept {
+		R * released = object;
+		object = nullptr;
+		return released;
+	}
+
+	// Writes n more refcount_ptrs to the same object to out, adding their
+	// references with a single increment of the reference count.
+	template<typename OutputIterator>
+	OutputIterator share(std::size_t n, OutputIterator out) const {
+		if (object && n) increment_refcount(object, n);
+		// Drops the references that weren't written if out throws.
+		auto guard = refcount_detail::on_unwind([&] { if (object && n) decrement_refcount(object, n); });
+		while (n > 0) {
+			Derived p(object, adopt_refcount);
+			--n;
+			*out++ = std::move(p);
+		}
+		guard.dismiss();
+		return out;
+	}
+
+	// Resets all of ptrs to null. References to the same object in adjacent
+	// elements are dropped with a single decrement of the reference count.
+	static void reset_all(range<Derived> ptrs) noexcept {
+		std::size_t i = 0;
+		while (i < ptrs.size()) {
+			R * released = ptrs[i++].release();
+			std::size_t n = 1;
+			while (i < ptrs.size() && ptrs[i].object == released) {
+				ptrs[i++].object = nullptr;
+				++n;
+			}
+			if (released) decrement_refcount(released, n);
+		}
+	}
+};
+
+}
+
+template<typename T>
+class refcount_ptr : public refcount_detail::refcount_ptr_base<refcount_ptr<T>, refcount_detail::refcounted_type_for<T>> {
+
+	using base = refcount_detail::refcount_ptr_base<refcount_ptr<T>, refcount_detail::refcounted_type_for<T>>;
 
 public:
 	using element_type = T;
@@ -65,35 +681,37 @@ private:
 	using mutable_element_type = typename std::remove_const<element_type>::type;
 
 public:
-	using refcounted_type = typename std::conditional<
-		std::is_convertible<mutable_element_type *, refcounted *>::value,
-		mutable_element_type,
-		refcount_wrapper<mutable_element_type>
-	>::type;
+	using refcounted_type = refcount_detail::refcounted_type_for<T>;
 
 private:
-	refcounted_type * object;
+	using base::object;
 
 	template<typename>
 	friend class refcount_ptr;
 
+	template<typename, typename>
+	friend class refcount_detail::refcount_ptr_base;
+
 	template<typename T2, typename... Args>
 	friend refcount_ptr<T2> make_refcount(Args &&...);
 
-public:
-	refcount_ptr(std::nullptr_t = nullptr) noexcept : object(nullptr) {}
+	template<typename T2, typename Alloc, typename... Args>
+	friend refcount_ptr<T2> allocate_refcount(Alloc const &, Args &&...);
 
-	refcount_ptr(refcounted_type * object) noexcept : object(object) {
-		if (object) increment_refcount(object);
-	}
+	template<typename>
+	friend class weak_refcount_ptr;
 
-	refcount_ptr(refcount_ptr const & other) noexcept : object(other.object) {
-		if (object) increment_refcount(object);
-	}
+	template<typename>
+	friend class atomic_refcount_ptr;
 
-	refcount_ptr(refcount_ptr && other) noexcept : object(other.object) {
-		other.object = nullptr;
-	}
+public:
+	refcount_ptr(std::nullptr_t = nullptr) noexcept {}
+
+	refcount_ptr(refcounted_type * object) noexcept : base(object) {}
+
+	// Takes over a reference that was already counted, such as one added by
+	// increment_refcount(object, n) or given up by release().
+	refcount_ptr(refcounted_type * object, adopt_refcount_t) noexcept : base(object, adopt_refcount) {}
 
 	template<
 		typename T2,
@@ -101,7 +719,12 @@ public:
 			std::is_convertible<T2 *, refcounted_type *>::value
 		>::type
 	>
-	refcount_ptr(std::unique_ptr<T2> object) noexcept : object(object.release()) {}
+	refcount_ptr(std::unique_ptr<T2> object) noexcept : base(object.release(), adopt_refcount) {
+		static_assert(
+			!std::is_same<refcount_policy_of<refcounted_type>, weak_refcount>::value,
+			"objects with a weak_refcount must be created by make_refcount or allocate_refcount"
+		);
+	}
 
 	template<
 		typename T2,
@@ -112,9 +735,7 @@ public:
 			>::value
 		>::type
 	>
-	refcount_ptr(refcount_ptr<T2> const & other) noexcept : object(other.object) {
-		if (object) increment_refcount(object);
-	}
+	refcount_ptr(refcount_ptr<T2> const & other) noexcept : base(other.object) {}
 
 	template<
 		typename T2,
@@ -125,29 +746,10 @@ public:
 			>::value
 		>::type
 	>
-	refcount_ptr(refcount_ptr<T2> && other) noexcept : object(other.object) {
-		other.object = nullptr;
-	}
+	refcount_ptr(refcount_ptr<T2> && other) noexcept : base(other.release(), adopt_refcount) {}
 
 	refcount_ptr & operator=(refcounted_type * other) noexcept {
-		if (other != object) {
-			if (object) decrement_refcount(object);
-			object = other;
-			if (object) increment_refcount(object);
-		}
-		return *this;
-	}
-
-	refcount_ptr & operator=(refcount_ptr const & other) noexcept {
-		return *this = other.object;
-	}
-
-	refcount_ptr & operator=(refcount_ptr && other) noexcept {
-		if (&other != this) {
-			if (object) decrement_refcount(object);
-			object = other.object;
-			other.object = nullptr;
-		}
+		this->assign(other);
 		return *this;
 	}
 
@@ -161,7 +763,8 @@ public:
 		>::type
 	>
 	refcount_ptr & operator=(refcount_ptr<T2> const & other) noexcept {
-		return *this = other.object;
+		this->assign(other.object);
+		return *this;
 	}
 
 	template<
@@ -174,24 +777,14 @@ public:
 		>::type
 	>
 	refcount_ptr & operator=(refcount_ptr<T2> && other) noexcept {
-		if (object) decrement_refcount(object);
-		object = other.object;
-		other.object = nullptr;
+		this->assign_adopted(other.release());
 		return *this;
 	}
 
-	~refcount_ptr() noexcept {
-		if (object) decrement_refcount(object);
-	}
-
 	element_type * get() const noexcept {
 		return object ? unwrap(object) : nullptr;
 	}
 
-	explicit operator bool () const noexcept {
-		return object != nullptr;
-	}
-
 	element_type & operator*() const noexcept {
 		return *unwrap(object);
 	}
@@ -200,19 +793,20 @@ public:
 		return unwrap(object);
 	}
 
-	std::size_t use_count() const noexcept {
-		return object ? mstd::use_count(object) : 0;
-	}
-
-	refcounted_type * unique() const noexcept {
-		return use_count() == 1 ? object : nullptr;
+	// Prepares the object to be shared with other threads.
+	// Only needed for objects with a biased_refcount, for which this must be
+	// called on the thread that created the object.
+	void handoff() const noexcept {
+		if (object) handoff_refcount(object);
 	}
 
+	// Objects made by allocate_refcount are never released, since they
+	// can't be deleted by a std::unique_ptr.
 	std::unique_ptr<refcounted_type> release_unique() {
-		if (use_count() != 1) return nullptr;
+		if (this->use_count() != 1 || refcount_detail::is_allocated(object)) return nullptr;
 		std::unique_ptr<refcounted_type> unique_ptr(object);
 		object = nullptr;
-		return std::move(unique_ptr);
+		return unique_ptr;
 	}
 
 	template<typename T2, typename T1>
@@ -226,7 +820,110 @@ public:
 
 private:
 	static T * unwrap(T * x) noexcept { return x; }
-	static T * unwrap(refcount_wrapper<T> * x) noexcept { return &x->wrapped; }
+	static T * unwrap(refcount_wrapper<mutable_element_type> * x) noexcept { return &x->wrapped; }
+};
+
+// A weak reference to an object with a weak_refcount, such as one deriving
+// from refcounted_weak.
+//
+// It does not keep the object alive, only its counts. lock() gives a
+// refcount_ptr to the object, or a null refcount_ptr if it no longer exists.
+template<typename T>
+class weak_refcount_ptr {
+
+public:
+	using element_type = T;
+
+	using refcounted_type = typename refcount_ptr<T>::refcounted_type;
+
+	static_assert(
+		std::is_same<refcount_policy_of<refcounted_type>, weak_refcount>::value,
+		"weak_refcount_ptr needs a type with a weak_refcount, such as refcounted_weak"
+	);
+
+private:
+	refcounted_type * object;
+	weak_refcount::counts * counts;
+
+	template<typename>
+	friend class weak_refcount_ptr;
+
+public:
+	weak_refcount_ptr(std::nullptr_t = nullptr) noexcept : object(nullptr), counts(nullptr) {}
+
+	template<
+		typename T2,
+		typename = typename std::enable_if<
+			std::is_convertible<T2 *, T *>::value && std::is_convertible<
+				typename refcount_ptr<T2>::refcounted_type *,
+				refcounted_type *
+			>::value
+		>::type
+	>
+	weak_refcount_ptr(refcount_ptr<T2> const & p) noexcept
+		: object(p.object), counts(nullptr)
+	{
+		if (object) {
+			counts = refcount_detail::access::references<weak_refcount>(object).counts_;
+			counts->weak.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	weak_refcount_ptr(weak_refcount_ptr const & other) noexcept
+		: object(other.object), counts(other.counts)
+	{
+		if (counts) counts->weak.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	weak_refcount_ptr(weak_refcount_ptr && other) noexcept
+		: object(other.object), counts(other.counts)
+	{
+		other.object = nullptr;
+		other.counts = nullptr;
+	}
+
+	weak_refcount_ptr & operator=(weak_refcount_ptr const & other) noexcept {
+		if (other.counts) other.counts->weak.fetch_add(1, std::memory_order_relaxed);
+		if (counts) refcount_detail::release_weak(counts);
+		object = other.object;
+		counts = other.counts;
+		return *this;
+	}
+
+	weak_refcount_ptr & operator=(weak_refcount_ptr && other) noexcept {
+		if (&other != this) {
+			if (counts) refcount_detail::release_weak(counts);
+			object = other.object;
+			counts = other.counts;
+			other.object = nullptr;
+			other.counts = nullptr;
+		}
+		return *this;
+	}
+
+	~weak_refcount_ptr() noexcept {
+		if (counts) refcount_detail::release_weak(counts);
+	}
+
+	void reset() noexcept {
+		*this = nullptr;
+	}
+
+	// Returns a refcount_ptr to the object, if it still exists.
+	refcount_ptr<T> lock() const noexcept {
+		refcount_ptr<T> p;
+		if (counts && weak_refcount::try_increment(*counts)) p.object = object;
+		return p;
+	}
+
+	bool expired() const noexcept {
+		return use_count() == 0;
+	}
+
+	std::size_t use_count() const noexcept {
+		if (!counts) return 0;
+		return counts->strong.load(std::memory_order_relaxed) & ~refcount_detail::allocated;
+	}
 };
 
 template<typename T2, typename T>
@@ -235,7 +932,7 @@ refcount_ptr<T2> static_pointer_cast(refcount_ptr<T> p) {
 	refcount_ptr<T2> p2;
 	p2.object = static_cast<typename refcount_ptr<T2>::refcounted_type *>(p.object);
 	p.object = nullptr;
-	return std::move(p2);
+	return p2;
 }
 
 template<typename T2, typename T>
@@ -250,7 +947,7 @@ refcount_ptr<T2> dynamic_pointer_cast(refcount_ptr<T> && p) {
 	refcount_ptr<T2> p2;
 	p2.object = dynamic_cast<typename refcount_ptr<T2>::refcounted_type *>(p.object);
 	if (p2.object) p.object = nullptr;
-	return std::move(p2);
+	return p2;
 }
 
 template<typename A, typename B>
@@ -283,17 +980,310 @@ bool operator!=(refcount_ptr<T> const & p, std::nullptr_t) {
 	return bool(p);
 }
 
+namespace refcount_detail {
+
+struct maker {
+	template<typename T, typename... Args>
+	static refcount_ptr<T> make(std::false_type /* weak */, Args &&... args) {
+		using refcounted_type = typename refcount_ptr<T>::refcounted_type;
+		return std::unique_ptr<refcounted_type>(new refcounted_type(std::forward<Args>(args)...));
+	}
+
+	// Needs the allocation header for its counts.
+	template<typename T, typename... Args>
+	static refcount_ptr<T> make(std::true_type /* weak */, Args &&... args) {
+		using refcounted_type = typename refcount_ptr<T>::refcounted_type;
+		return allocate_refcount<T>(std::allocator<refcounted_type>(), std::forward<Args>(args)...);
+	}
+};
+
+}
+
 template<typename T, typename... Args>
 refcount_ptr<T> make_refcount(Args &&... args) {
-	return std::make_unique<typename refcount_ptr<T>::refcounted_type>(std::forward<Args>(args)...);
+	using refcounted_type = typename refcount_ptr<T>::refcounted_type;
+	return refcount_detail::maker::make<T>(
+		std::is_same<refcount_policy_of<refcounted_type>, weak_refcount>(),
+		std::forward<Args>(args)...
+	);
 }
 
+// Like make_refcount, but allocates the object with the given allocator.
+//
+// A copy of the allocator is stored in the same allocation, in front of the
+// object, and is used to deallocate it when the last reference is dropped.
+// Empty allocators take no space. Only the deallocation function pointer is
+// stored in that case.
+template<typename T, typename Alloc, typename... Args>
+refcount_ptr<T> allocate_refcount(Alloc const & alloc, Args &&... args) {
+	using refcounted_type = typename refcount_ptr<T>::refcounted_type;
+	refcount_ptr<T> p;
+	p.object = refcount_detail::allocation<refcounted_type, Alloc>::create(alloc, std::forward<Args>(args)...);
+	return p;
+}
+
+// Takes the object out of p if p is its only owner, or copies it otherwise.
+// p is null afterwards if the object was taken.
+//
+// Not available for objects with a weak_refcount, which can't be owned by a
+// std::unique_ptr. Use make_mutable for those.
 template<typename T>
 std::unique_ptr<typename refcount_ptr<T>::refcounted_type>
 take_or_copy(refcount_ptr<T> & p) {
+	using refcounted_type = typename refcount_ptr<T>::refcounted_type;
+	static_assert(
+		!std::is_same<refcount_policy_of<refcounted_type>, weak_refcount>::value,
+		"take_or_copy does not support objects with a weak_refcount, use make_mutable instead"
+	);
 	auto copy = p.release_unique();
-	if (!copy) copy = std::make_unique<typename refcount_ptr<T>::refcounted_type>(*p);
-	return std::move(copy);
+	if (!copy) copy.reset(new refcounted_type(*p));
+	return copy;
+}
+
+namespace refcount_detail {
+
+// Whether other references can see the object: other refcount_ptrs, or weak
+// references, which could be locked at any time.
+template<typename T>
+bool is_shared(refcount_ptr<T> const & p, std::false_type /* weak */) noexcept {
+	return p.use_count() != 1;
+}
+
+template<typename T>
+bool is_shared(refcount_ptr<T> const & p, std::true_type /* weak */) noexcept {
+	// Nobody can add a weak reference otherwise, since p is the only strong one.
+	return p.use_count() != 1 || access::references<weak_refcount>(p.get()).counts_->weak.load(std::memory_order_acquire) != 1;
+}
+
+// Whether *object is a T, and not some class derived from it, which copying
+// it as a T would slice. Only checked with RTTI.
+template<typename T>
+bool is_exact_type(T const &, std::false_type /* polymorphic */) noexcept { return true; }
+
+template<typename T>
+bool is_exact_type(T const & object, std::true_type /* polymorphic */) noexcept {
+#if defined(__cpp_rtti) || defined(__GXX_RTTI) || defined(_CPPRTTI)
+	return typeid(object) == typeid(T);
+#else
+	(void)object;
+	return true;
+#endif
+}
+
+template<typename T, typename Copy>
+typename std::remove_const<T>::type & make_mutable(refcount_ptr<T> & p, Copy copy) {
+	using mutable_type = typename std::remove_const<T>::type;
+	using policy = refcount_policy_of<typename refcount_ptr<T>::refcounted_type>;
+	assert(p && "make_mutable: null refcount_ptr");
+	if (is_shared(p, std::is_same<policy, weak_refcount>())) {
+		assert(is_exact_type<mutable_type>(*p, std::is_polymorphic<mutable_type>()) && "make_mutable: object would be sliced");
+		refcount_ptr<mutable_type> c = copy(*p);
+		mutable_type & object = *c;
+		p = std::move(c);
+		return object;
+	}
+	// Fine, since the object itself is never created const.
+	return const_cast<mutable_type &>(*p);
+}
+
+}
+
+// Gives mutable access to the object p points to, copying it first if it is
+// shared with other refcount_ptrs. Unlike take_or_copy, a unique object stays
+// where it is, and p keeps pointing to it. p must not be null.
+//
+// For objects with a weak_refcount, it also always copies when there are weak
+// references, since those could be locked at any time.
+//
+// The copy is made by make_refcount, as a T. So p must point to a T, not to a
+// class derived from it (which is asserted for polymorphic types, with RTTI).
+// For objects made by allocate_refcount, pass the allocator to copy with.
+template<typename T>
+typename std::remove_const<T>::type & make_mutable(refcount_ptr<T> & p) {
+	using mutable_type = typename std::remove_const<T>::type;
+	return refcount_detail::make_mutable(p, [] (mutable_type const & x) { return make_refcount<mutable_type>(x); });
+}
+
+template<typename T, typename Alloc>
+typename std::remove_const<T>::type & make_mutable(refcount_ptr<T> & p, Alloc const & alloc) {
+	using mutable_type = typename std::remove_const<T>::type;
+	return refcount_detail::make_mutable(p, [&alloc] (mutable_type const & x) { return allocate_refcount<mutable_type>(alloc, x); });
+}
+
+// A copy-on-write pointer. Copies share the same object, until one of them
+// is modified through write(), which copies the object only if it is shared.
+//
+// Example:
+//   mstd::cow_ptr<Node> a = mstd::make_refcount<Node const>(...);
+//   mstd::cow_ptr<Node> b = a; // Shares the Node.
+//   b.write().x = 1;           // Copies it, since it is shared.
+//   b.write().y = 2;           // Modifies it in place.
+template<typename T>
+class cow_ptr {
+
+	refcount_ptr<T const> p;
+
+public:
+	using element_type = T;
+
+	cow_ptr(std::nullptr_t = nullptr) noexcept {}
+
+	cow_ptr(refcount_ptr<T const> p) noexcept : p(std::move(p)) {}
+
+	T const * get() const noexcept { return p.get(); }
+
+	explicit operator bool () const noexcept { return bool(p); }
+
+	T const & operator*() const noexcept { return *p; }
+
+	T const * operator->() const noexcept { return p.get(); }
+
+	// Must not be called on a null cow_ptr. Copies with make_refcount, see
+	// make_mutable.
+	T & write() { return make_mutable(p); }
+
+	refcount_ptr<T const> const & shared() const noexcept { return p; }
+
+	std::size_t use_count() const noexcept { return p.use_count(); }
+};
+
+
+// The object a refcount_ptr<T[]> points to.
+//
+// The reference count and the number of elements, directly followed by the
+// elements themselves, all in a single allocation.
+template<typename T>
+class alignas(T) alignas(refcounted) refcount_array final : public refcounted {
+	static_assert(alignof(T) <= alignof(std::max_align_t), "over-aligned array elements are not supported");
+
+	std::size_t size_;
+
+	template<typename... Args>
+	explicit refcount_array(std::size_t n, Args const &... args) : size_(0) {
+		auto guard = refcount_detail::on_unwind([this] { destroy_elements(); });
+		for (; size_ < n; ++size_) ::new (static_cast<void *>(data() + size_)) T(args...);
+		guard.dismiss();
+	}
+
+	void destroy_elements() noexcept {
+		while (size_) data()[--size_].~T();
+	}
+
+	template<typename T2, typename... Args>
+	friend refcount_ptr<T2[]> make_refcount_array(std::size_t, Args const &...);
+
+public:
+	~refcount_array() { destroy_elements(); }
+
+	static void operator delete(void * p) noexcept { ::operator delete(p); }
+
+	T       * data()       noexcept { return reinterpret_cast<T       *>(this + 1); }
+	T const * data() const noexcept { return reinterpret_cast<T const *>(this + 1); }
+
+	std::size_t size() const noexcept { return size_; }
+};
+
+// A refcount_ptr to an array of elements, made by make_refcount_array, which
+// puts the reference count, the size, and the elements in a single allocation.
+template<typename T>
+class refcount_ptr<T[]> : public refcount_detail::refcount_ptr_base<refcount_ptr<T[]>, refcount_array<typename std::remove_const<T>::type>> {
+
+	using base = refcount_detail::refcount_ptr_base<refcount_ptr<T[]>, refcount_array<typename std::remove_const<T>::type>>;
+
+public:
+	using element_type = T;
+
+	using refcounted_type = refcount_array<typename std::remove_const<T>::type>;
+
+private:
+	using base::object;
+
+	template<typename>
+	friend class refcount_ptr;
+
+	template<typename, typename>
+	friend class refcount_detail::refcount_ptr_base;
+
+	template<typename T2, typename... Args>
+	friend refcount_ptr<T2[]> make_refcount_array(std::size_t, Args const &...);
+
+public:
+	refcount_ptr(std::nullptr_t = nullptr) noexcept {}
+
+	refcount_ptr(refcounted_type * object) noexcept : base(object) {}
+
+	// Takes over a reference that was already counted, such as one added by
+	// increment_refcount(object, n) or given up by release().
+	refcount_ptr(refcounted_type * object, adopt_refcount_t) noexcept : base(object, adopt_refcount) {}
+
+	// Only adds const, e.g. refcount_ptr<char[]> to refcount_ptr<char const[]>.
+	template<
+		typename T2,
+		typename = typename std::enable_if<
+			std::is_convertible<T2 *, T *>::value &&
+			std::is_same<typename refcount_ptr<T2[]>::refcounted_type, refcounted_type>::value
+		>::type
+	>
+	refcount_ptr(refcount_ptr<T2[]> const & other) noexcept : base(other.object) {}
+
+	template<
+		typename T2,
+		typename = typename std::enable_if<
+			std::is_convertible<T2 *, T *>::value &&
+			std::is_same<typename refcount_ptr<T2[]>::refcounted_type, refcounted_type>::value
+		>::type
+	>
+	refcount_ptr(refcount_ptr<T2[]> && other) noexcept : base(other.release(), adopt_refcount) {}
+
+	element_type * get() const noexcept {
+		return object ? object->data() : nullptr;
+	}
+
+	element_type * data() const noexcept { return get(); }
+
+	std::size_t size() const noexcept { return object ? object->size() : 0; }
+
+	bool empty() const noexcept { return size() == 0; }
+
+	element_type * begin() const noexcept { return get(); }
+	element_type *   end() const noexcept { return get() + size(); }
+
+	element_type & operator [] (std::size_t i) const noexcept { return object->data()[i]; }
+
+	range<element_type> elements() const noexcept { return {get(), size()}; }
+};
+
+namespace refcount_detail {
+
+// Kept out of line, to keep the exception out of make_refcount_array.
+#if defined(__GNUC__) || defined(__clang__)
+__attribute__((noinline, cold))
+#endif
+[[noreturn]] inline void bad_array_new_length() {
+#if defined(__cpp_exceptions) || defined(__EXCEPTIONS) || defined(_CPPUNWIND)
+	throw std::bad_array_new_length();
+#else
+	std::abort();
+#endif
+}
+
+}
+
+// Makes an array of n elements, each constructed from args.
+// (So, value-initialized if no args are given.)
+//
+// Throws std::bad_array_new_length if the size in bytes doesn't fit in a
+// std::size_t, or aborts if exceptions are disabled.
+template<typename T, typename... Args>
+refcount_ptr<T[]> make_refcount_array(std::size_t n, Args const &... args) {
+	using refcounted_type = refcount_array<T>;
+	if (n > (std::size_t(-1) - sizeof(refcounted_type)) / sizeof(T)) refcount_detail::bad_array_new_length();
+	void * storage = ::operator new(sizeof(refcounted_type) + n * sizeof(T));
+	auto guard = refcount_detail::on_unwind([storage] { ::operator delete(storage); });
+	refcount_ptr<T[]> p;
+	p.object = ::new (storage) refcounted_type(n, args...);
+	guard.dismiss();
+	return p;
 }
 
 }
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+
+#include "range.hpp"
+
+namespace mstd {
+
+namespace split_detail {
+
+// A Finder gives the index of the next delimiter in a range, or npos, and
+// trims each piece.
+
+template<typename T>
+struct by_element {
+	typename std::remove_cv<T>::type delimiter;
+
+	static constexpr bool skip_trailing_empty = false;
+
+	std::size_t find(range<T> r) const { return r.find(delimiter); }
+
+	void trim(range<T> &) const {}
+};
+
+// Any of the delimiters, checked one by one.
+template<typename T, bool = range_detail::use_memchr<T>::value>
+struct by_any {
+	range<T const> delimiters;
+
+	explicit by_any(range<T const> d) : delimiters(d) {}
+
+	static constexpr bool skip_trailing_empty = false;
+
+	std::size_t find(range<T> r) const {
+		for (std::size_t i = 0; i < r.size(); ++i) {
+			for (auto const & d : delimiters) if (r[i] == d) return i;
+		}
+		return range<T>::npos;
+	}
+
+	void trim(range<T> &) const {}
+};
+
+// Any of the delimiters, for byte-sized elements, looked up in a table.
+template<typename T>
+struct by_any<T, true> {
+	bool is_delimiter[256];
+
+	explicit by_any(range<T const> delimiters) : is_delimiter{} {
+		for (auto const & d : delimiters) is_delimiter[static_cast<unsigned char>(d)] = true;
+	}
+
+	static constexpr bool skip_trailing_empty = false;
+
+	std::size_t find(range<T> r) const {
+		for (std::size_t i = 0; i < r.size(); ++i) {
+			if (is_delimiter[static_cast<unsigned char>(r[i])]) return i;
+		}
+		return range<T>::npos;
+	}
+
+	void trim(range<T> &) const {}
+};
+
+// Lines end in "\n" or "\r\n". A last line without a line ending also
+// counts, but nothing after the last line ending does.
+template<typename T>
+struct by_line {
+	static constexpr bool skip_trailing_empty = true;
+
+	std::size_t find(range<T> r) const { return r.find('\n'); }
+
+	void trim(range<T> & line) const {
+		if (!line.empty() && line[line.size() - 1] == '\r') line.remove_suffix(1);
+	}
+};
+
+}
+
+// A lazy sequence of the pieces of a range between delimiters, as made by
+// split(), split_any() and lines().
+//
+// The pieces are subranges of the original range, which must outlive the
+// split_view. Nothing is copied or allocated. Finding the next delimiter
+// only happens when advancing the iterator.
+template<typename T, typename Finder>
+class split_view {
+
+	range<T> input_;
+	Finder finder_;
+
+public:
+	class iterator {
+		Finder const * finder_;
+		range<T> piece_;
+		range<T> rest_;
+		bool more_; // Whether there is another piece after piece_.
+		bool end_;
+
+		void next() {
+			if (!more_) {
+				end_ = true;
+				return;
+			}
+			std::size_t i = finder_->find(rest_);
+			if (i == range<T>::npos) {
+				piece_ = rest_;
+				rest_.remove_prefix(rest_.size());
+				more_ = false;
+			} else {
+				piece_ = rest_.subrange(0, i);
+				rest_.remove_prefix(i + 1);
+				more_ = !(Finder::skip_trailing_empty && rest_.empty());
+			}
+			finder_->trim(piece_);
+		}
+
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type        = range<T>;
+		using difference_type   = std::ptrdiff_t;
+		using pointer           = range<T> const *;
+		using reference         = range<T> const &;
+
+		iterator() : finder_(nullptr), more_(false), end_(true) {}
+
+		iterator(Finder const * finder, range<T> input, bool more)
+			: finder_(finder), rest_(input), more_(more), end_(false) { next(); }
+
+		reference operator * () const { return piece_; }
+		pointer  operator -> () const { return &piece_; }
+
+		iterator & operator ++ () {
+			next();
+			return *this;
+		}
+
+		iterator operator ++ (int) {
+			iterator old = *this;
+			next();
+			return old;
+		}
+
+		// Everything after the current piece and its delimiter.
+		range<T> rest() const { return rest_; }
+
+		friend bool operator == (iterator const & a, iterator const & b) {
+			if (a.end_ || b.end_) return a.end_ == b.end_;
+			return a.piece_.data() == b.piece_.data() && a.piece_.size() == b.piece_.size();
+		}
+
+		friend bool operator != (iterator const & a, iterator const & b) {
+			return !(a == b);
+		}
+	};
+
+	split_view(range<T> input, Finder finder) : input_(input), finder_(finder) {}
+
+	iterator begin() const {
+		return iterator(&finder_, input_, !(Finder::skip_trailing_empty && input_.empty()));
+	}
+
+	iterator end() const { return iterator(); }
+};
+
+// Splits r at every delimiter.
+//
+// Like in most languages' split, a delimiter at the start or end, or two
+// delimiters next to each other, give an empty piece. An empty r gives a
+// single empty piece.
+//
+// Example:
+//   for (mstd::range<char const> field : mstd::split(line, ',')) {
+//     ...
+//   }
+template<typename T>
+split_view<T, split_detail::by_element<T>> split(range<T> r, typename std::remove_cv<T>::type delimiter) {
+	return {r, split_detail::by_element<T>{delimiter}};
+}
+
+// Splits r at every element that is one of the delimiters.
+//
+// For byte-sized elements, the delimiters are put in a lookup table.
+// Otherwise, only the range of delimiters is stored, so they must outlive the
+// split_view. (Note that a string literal would include its terminating null
+// character.)
+template<typename T>
+split_view<T, split_detail::by_any<T>> split_any(range<T> r, range<typename std::add_const<T>::type> delimiters) {
+	return {r, split_detail::by_any<T>(delimiters)};
+}
+
+// Splits r into lines, without their "\n" or "\r\n".
+template<typename T>
+split_view<T, split_detail::by_line<T>> lines(range<T> r) {
+	return {r, split_detail::by_line<T>{}};
+}
+
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+
+#include "range.hpp"
+
+namespace mstd {
+
+// Like range<T>, but with a fixed distance (the stride, in elements) between
+// consecutive elements. For example a column of a matrix, or one channel of
+// interleaved data.
+//
+// Example:
+//   float rgb[300];
+//   mstd::strided_range<float> green{rgb + 1, 100, 3};
+template<typename T>
+struct strided_range {
+
+	// Keeps an index rather than a pointer, since the position after the
+	// last element might be further than one past the end of the array.
+	class iterator {
+		T * base_;
+		std::ptrdiff_t index_;
+		std::ptrdiff_t stride_;
+
+	public:
+		using iterator_category = std::random_access_iterator_tag;
+		using value_type        = typename std::remove_cv<T>::type;
+		using difference_type   = std::ptrdiff_t;
+		using pointer           = T *;
+		using reference         = T &;
+
+		constexpr iterator() : base_(nullptr), index_(0), stride_(1) {}
+		constexpr iterator(T * base, std::ptrdiff_t index, std::ptrdiff_t stride) : base_(base), index_(index), stride_(stride) {}
+
+		constexpr T & operator * () const { return base_[index_ * stride_]; }
+		constexpr T * operator -> () const { return &base_[index_ * stride_]; }
+		constexpr T & operator [] (std::ptrdiff_t i) const { return base_[(index_ + i) * stride_]; }
+
+		constexpr iterator & operator ++ () { ++index_; return *this; }
+		constexpr iterator & operator -- () { --index_; return *this; }
+		constexpr iterator operator ++ (int) { iterator old = *this; ++index_; return old; }
+		constexpr iterator operator -- (int) { iterator old = *this; --index_; return old; }
+
+		constexpr iterator & operator += (std::ptrdiff_t n) { index_ += n; return *this; }
+		constexpr iterator & operator -= (std::ptrdiff_t n) { index_ -= n; return *this; }
+
+		friend constexpr iterator operator + (iterator i, std::ptrdiff_t n) { return i += n; }
+		friend constexpr iterator operator + (std::ptrdiff_t n, iterator i) { return i += n; }
+		friend constexpr iterator operator - (iterator i, std::ptrdiff_t n) { return i -= n; }
+
+		friend constexpr std::ptrdiff_t operator - (iterator a, iterator b) { return a.index_ - b.index_; }
+
+		friend constexpr bool operator == (iterator a, iterator b) { return a.index_ == b.index_; }
+		friend constexpr bool operator != (iterator a, iterator b) { return a.index_ != b.index_; }
+		friend constexpr bool operator <  (iterator a, iterator b) { return a.index_ <  b.index_; }
+		friend constexpr bool operator >  (iterator a, iterator b) { return a.index_ >  b.index_; }
+		friend constexpr bool operator <= (iterator a, iterator b) { return a.index_ <= b.index_; }
+		friend constexpr bool operator >= (iterator a, iterator b) { return a.index_ >= b.index_; }
+	};
+
+	constexpr strided_range() : begin_(nullptr), size_(0), stride_(1) {}
+
+	constexpr strided_range(decltype(nullptr)) : begin_(nullptr), size_(0), stride_(1) {}
+
+	constexpr strided_range(T * b, std::size_t s, std::ptrdiff_t stride) : begin_(b), size_(s), stride_(stride) {}
+
+	// A contiguous range has a stride of 1.
+	template<
+		typename T2,
+		typename = std::enable_if_t<std::is_convertible<T2 *, T *>::value>
+	>
+	constexpr strided_range(range<T2> r) : begin_(r.data()), size_(r.size()), stride_(1) {}
+
+	template<
+		typename T2,
+		typename = std::enable_if_t<std::is_convertible<T2 *, T *>::value>
+	>
+	constexpr strided_range(strided_range<T2> r) : begin_(r.data()), size_(r.size()), stride_(r.stride()) {}
+
+	constexpr T & operator [] (std::size_t i) const { return begin_[std::ptrdiff_t(i) * stride_]; }
+
+	constexpr iterator begin() const { return {begin_, 0, stride_}; }
+	constexpr iterator   end() const { return {begin_, std::ptrdiff_t(size_), stride_}; }
+
+	// (Never moves begin_ past the last element, since that might be further
+	// than one past the end of the array.)
+	constexpr void remove_prefix(std::size_t n) {
+		if (n < size_) begin_ += std::ptrdiff_t(n) * stride_;
+		size_ -= n;
+	}
+	constexpr void remove_suffix(std::size_t n) { size_ -= n; }
+
+	constexpr std::size_t size() const { return size_; }
+
+	constexpr std::ptrdiff_t stride() const { return stride_; }
+
+	// The first element.
+	constexpr T * data() const { return begin_; }
+
+	constexpr bool empty() const { return size_ == 0; }
+
+	constexpr strided_range subrange(std::size_t pos, std::size_t count = std::size_t(-1)) const {
+		strided_range r = *this;
+		r.remove_prefix(pos);
+		if (r.size_ > count) r.size_ = count;
+		return r;
+	}
+
+	// Every n-th element, starting with the first.
+	constexpr strided_range every(std::size_t n) const {
+		return strided_range(begin_, (size_ + n - 1) / n, stride_ * std::ptrdiff_t(n));
+	}
+
+	// Whether the elements are next to each other, such that this can be
+	// converted to a range<T>.
+	constexpr bool contiguous() const { return stride_ == 1 || size_ <= 1; }
+
+	constexpr range<T> as_range() const {
+		assert(contiguous());
+		return {begin_, size_};
+	}
+
+	friend constexpr bool operator == (strided_range a, strided_range b) {
+		if (a.size() != b.size()) return false;
+		for (std::size_t i = 0; i < a.size(); ++i) if (!(a[i] == b[i])) return false;
+		return true;
+	}
+
+	friend constexpr bool operator != (strided_range a, strided_range b) {
+		if (a.size() != b.size()) return true;
+		for (std::size_t i = 0; i < a.size(); ++i) if (a[i] != b[i]) return true;
+		return false;
+	}
+
+private:
+	T * begin_;
+	std::size_t size_;
+	std::ptrdiff_t stride_;
+};
+
+}
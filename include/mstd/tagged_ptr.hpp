@@ -0,0 +1,211 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include "refcount.hpp"
+
+namespace mstd {
+
+namespace tagged_detail {
+
+constexpr unsigned log2(std::size_t x) {
+	unsigned n = 0;
+	while (x > 1) {
+		x >>= 1;
+		++n;
+	}
+	return n;
+}
+
+}
+
+// A pointer with Bits bits of extra information (the tag) stored in its
+// lowest bits, which are always zero because of the alignment of T.
+//
+// Bits = 0 means as many bits as alignof(T) allows (e.g. 3 bits for an 8-byte
+// aligned T). This is only computed when used, so T may be incomplete where
+// the tagged_ptr is declared.
+//
+// Example:
+//   struct node {
+//     mstd::tagged_ptr<node, 1> left; // Tag: whether left is red.
+//     mstd::tagged_ptr<node, 1> right;
+//   };
+template<typename T, unsigned Bits = 0>
+class tagged_ptr {
+
+	std::uintptr_t value_;
+
+public:
+	// The number of bits in the tag.
+	static constexpr unsigned bits() {
+		static_assert(Bits == 0 || (std::size_t(1) << Bits) <= alignof(T), "T is not aligned enough to store that many bits");
+		return Bits ? Bits : tagged_detail::log2(alignof(T));
+	}
+
+	// The largest tag, and the bits of the pointer used for the tag.
+	static constexpr std::uintptr_t tag_mask() { return (std::uintptr_t(1) << bits()) - 1; }
+
+	constexpr tagged_ptr() noexcept : value_(0) {}
+
+	constexpr tagged_ptr(std::nullptr_t) noexcept : value_(0) {}
+
+	tagged_ptr(T * p, std::uintptr_t tag = 0) noexcept : value_(reinterpret_cast<std::uintptr_t>(p) | tag) {
+		assert((reinterpret_cast<std::uintptr_t>(p) & tag_mask()) == 0);
+		assert(tag <= tag_mask());
+	}
+
+	T * get() const noexcept { return reinterpret_cast<T *>(value_ & ~tag_mask()); }
+
+	T & operator * () const noexcept { return *get(); }
+	T * operator -> () const noexcept { return get(); }
+
+	// Whether the pointer (not the tag) is non-null.
+	explicit operator bool() const noexcept { return get() != nullptr; }
+
+	// Replaces the pointer, keeping the tag.
+	void set(T * p) noexcept {
+		assert((reinterpret_cast<std::uintptr_t>(p) & tag_mask()) == 0);
+		value_ = reinterpret_cast<std::uintptr_t>(p) | tag();
+	}
+
+	std::uintptr_t tag() const noexcept { return value_ & tag_mask(); }
+
+	void set_tag(std::uintptr_t tag) noexcept {
+		assert(tag <= tag_mask());
+		value_ = (value_ & ~tag_mask()) | tag;
+	}
+
+	bool tag_bit(unsigned i) const noexcept {
+		assert(i < bits());
+		return value_ >> i & 1;
+	}
+
+	void set_tag_bit(unsigned i, bool bit = true) noexcept {
+		assert(i < bits());
+		value_ = (value_ & ~(std::uintptr_t(1) << i)) | std::uintptr_t(bit) << i;
+	}
+
+	// The pointer and tag together.
+	std::uintptr_t raw() const noexcept { return value_; }
+
+	// Compares both the pointer and the tag.
+
+	friend bool operator == (tagged_ptr a, tagged_ptr b) noexcept { return a.value_ == b.value_; }
+	friend bool operator != (tagged_ptr a, tagged_ptr b) noexcept { return a.value_ != b.value_; }
+};
+
+// A refcount_ptr<T> with Bits bits of tag stored in the alignment bits of the
+// pointer, like tagged_ptr. It takes the space of a single pointer.
+//
+// The tag doesn't affect the reference counting: get() and use_count() are
+// the same as for a refcount_ptr to the same object. Copies (that is, new
+// references) have the same tag, but changing the tag of one of them doesn't
+// change the others.
+//
+// Example:
+//   struct trie_node : mstd::refcounted {
+//     // Tag bit 0: whether the child is a leaf.
+//     mstd::tagged_refcount_ptr<trie_node, 1> children[16];
+//   };
+template<typename T, unsigned Bits = 0>
+class tagged_refcount_ptr {
+
+public:
+	using element_type = T;
+	using refcounted_type = typename refcount_ptr<T>::refcounted_type;
+
+private:
+	tagged_ptr<refcounted_type, Bits> ptr_;
+
+	// A refcount_ptr for the reference held by this, which must be released
+	// again.
+	refcount_ptr<T> borrow() const noexcept { return refcount_ptr<T>(ptr_.get(), adopt_refcount); }
+
+public:
+	static constexpr unsigned bits() { return tagged_ptr<refcounted_type, Bits>::bits(); }
+
+	tagged_refcount_ptr(std::nullptr_t = nullptr) noexcept {}
+
+	tagged_refcount_ptr(refcount_ptr<T> p, std::uintptr_t tag = 0) noexcept : ptr_(p.release(), tag) {}
+
+	tagged_refcount_ptr(tagged_refcount_ptr const & other) noexcept : ptr_(other.ptr_) {
+		if (ptr_) increment_refcount(ptr_.get());
+	}
+
+	tagged_refcount_ptr(tagged_refcount_ptr && other) noexcept : ptr_(other.ptr_) {
+		other.ptr_ = nullptr;
+	}
+
+	tagged_refcount_ptr & operator = (tagged_refcount_ptr const & other) noexcept {
+		if (other.ptr_.get() != ptr_.get()) {
+			if (other.ptr_) increment_refcount(other.ptr_.get());
+			if (ptr_) decrement_refcount(ptr_.get());
+		}
+		ptr_ = other.ptr_;
+		return *this;
+	}
+
+	tagged_refcount_ptr & operator = (tagged_refcount_ptr && other) noexcept {
+		if (&other != this) {
+			if (ptr_) decrement_refcount(ptr_.get());
+			ptr_ = other.ptr_;
+			other.ptr_ = nullptr;
+		}
+		return *this;
+	}
+
+	~tagged_refcount_ptr() noexcept {
+		if (ptr_) decrement_refcount(ptr_.get());
+	}
+
+	T * get() const noexcept {
+		refcount_ptr<T> p = borrow();
+		T * result = p.get();
+		p.release();
+		return result;
+	}
+
+	T & operator * () const noexcept { return *get(); }
+	T * operator -> () const noexcept { return get(); }
+
+	// Whether the pointer (not the tag) is non-null.
+	explicit operator bool() const noexcept { return bool(ptr_); }
+
+	std::size_t use_count() const noexcept {
+		return ptr_ ? mstd::use_count(ptr_.get()) : 0;
+	}
+
+	// A new reference to the object, without the tag.
+	refcount_ptr<T> ptr() const noexcept { return refcount_ptr<T>(ptr_.get()); }
+
+	// Gives up the reference as a refcount_ptr, leaving this null. The tag is
+	// kept.
+	refcount_ptr<T> release() noexcept {
+		refcount_ptr<T> p = borrow();
+		ptr_.set(nullptr);
+		return p;
+	}
+
+	// Replaces the pointer, keeping the tag.
+	void reset(refcount_ptr<T> p = nullptr) noexcept {
+		if (ptr_) decrement_refcount(ptr_.get());
+		ptr_.set(p.release());
+	}
+
+	std::uintptr_t tag() const noexcept { return ptr_.tag(); }
+	void set_tag(std::uintptr_t tag) noexcept { ptr_.set_tag(tag); }
+
+	bool tag_bit(unsigned i) const noexcept { return ptr_.tag_bit(i); }
+	void set_tag_bit(unsigned i, bool bit = true) noexcept { ptr_.set_tag_bit(i, bit); }
+
+	// Compares both the pointer and the tag.
+
+	friend bool operator == (tagged_refcount_ptr const & a, tagged_refcount_ptr const & b) noexcept { return a.ptr_ == b.ptr_; }
+	friend bool operator != (tagged_refcount_ptr const & a, tagged_refcount_ptr const & b) noexcept { return a.ptr_ != b.ptr_; }
+};
+
+}
@@ -1,17 +1,51 @@
 #pragma once
 
+#include <type_traits>
 #include <utility>
 
 namespace mstd {
 
+namespace unique_detail {
+
+// Stores the Closer. An empty Closer is a base class, such that it takes no
+// space.
+template<typename Closer, bool = std::is_empty<Closer>::value && !std::is_final<Closer>::value>
+struct closer_holder : private Closer {
+	closer_holder() : Closer() {}
+	explicit closer_holder(Closer c) : Closer(std::move(c)) {}
+
+	Closer       & get_closer()       { return *this; }
+	Closer const & get_closer() const { return *this; }
+};
+
+template<typename Closer>
+struct closer_holder<Closer, false> {
+	closer_holder() : closer_() {}
+	explicit closer_holder(Closer c) : closer_(std::move(c)) {}
+
+	Closer       & get_closer()       { return closer_; }
+	Closer const & get_closer() const { return closer_; }
+
+private:
+	Closer closer_;
+};
+
+}
+
 // Like an unique_ptr, but without the 'ptr' part.
 // Contains the value, instead of a pointer to a value.
-// If bool(value) == true on destruction, Closer()(value) will called.
+// If bool(value) == true on destruction, closer()(value) will called.
 // A default constructed T should convert to false: bool(T()) == false.
+//
+// The Closer can have state, for example to return the value to a pool it
+// came from. It is moved along with the value. A Closer without state takes
+// no space.
 template<typename T, typename Closer>
-struct unique {
+struct unique : private unique_detail::closer_holder<Closer> {
 
 private:
+	using holder = unique_detail::closer_holder<Closer>;
+
 	T value_;
 
 public:
@@ -19,21 +53,37 @@ public:
 
 	explicit unique(T value) : value_(std::move(value)) {}
 
-	unique(unique && other) : value_(other.release()) {}
+	unique(T value, Closer c) : holder(std::move(c)), value_(std::move(value)) {}
 
-	~unique() { if (value_) Closer()(value_); }
+	unique(unique && other) : holder(std::move(other.get_closer())), value_(other.release()) {}
+
+	~unique() { if (value_) this->get_closer()(value_); }
 
 	unique & operator = (unique && other) {
-		if (value_) Closer()(value_);
-		value_ = other.release();
+		if (this != &other) {
+			if (value_) this->get_closer()(value_);
+			this->get_closer() = std::move(other.get_closer());
+			value_ = other.release();
+		}
+		return *this;
 	}
 
 	T release() {
 		T v = std::move(value_);
 		value_ = T();
-		return std::move(v);
+		return v;
+	}
+
+	// Closes the current value, if any, and takes value instead. The closer
+	// is kept.
+	void reset(T value = T()) {
+		if (value_) this->get_closer()(value_);
+		value_ = std::move(value);
 	}
 
+	Closer       & closer()       { return this->get_closer(); }
+	Closer const & closer() const { return this->get_closer(); }
+
 	explicit operator bool() const { return bool(value_); }
 
 	T       &  get()       &  { return value_; }